@@ -1,16 +1,73 @@
 TEMPLATE = app
 TARGET = SetKeyMap
 INCLUDEPATH += .
-QT += widgets
+QT += widgets concurrent
+CONFIG += c++17
 DEFINES += QT_DEPRECATED_WARNINGS
 HEADERS += \
         winutil.hpp \
+        trace.hpp \
+        scancodemap.hpp \
+        scancodemapstore.hpp \
+        keymap.hpp \
+        keymaphash.hpp \
+        keymapanalyzer.hpp \
+        keymapalgebra.hpp \
+        keymapexport.hpp \
+        keymapimport.hpp \
+        keystrokesimulator.hpp \
+        profilelibrary.hpp \
+        profilestore.hpp \
+        commandline.hpp \
         mainwindow.hpp \
         editkeymapdialog.hpp \
-        keyboarddefs.hpp
+        keymaptablemodel.hpp \
+        keyselectdelegate.hpp \
+        keynameindex.hpp \
+        persistentkeymap.hpp \
+        keyboarddefs.hpp \
+        layoutpack.hpp
 SOURCES += \
         main.cpp \
         winutil.cpp \
+        trace.cpp \
+        scancodemap.cpp \
+        scancodemapstore.cpp \
+        keymaphash.cpp \
+        keymapanalyzer.cpp \
+        keymapalgebra.cpp \
+        keymapexport.cpp \
+        keymapimport.cpp \
+        keystrokesimulator.cpp \
+        profilelibrary.cpp \
+        profilestore.cpp \
+        commandline.cpp \
         mainwindow.cpp \
         editkeymapdialog.cpp \
-        keyboarddefs.cpp
+        keymaptablemodel.cpp \
+        keyselectdelegate.cpp \
+        keynameindex.cpp \
+        persistentkeymap.cpp \
+        keyboarddefs.cpp \
+        layoutpack.cpp
+
+# The layout sources are compiled into packs in "layouts" next to the
+# executable, where getLayoutPackNames() looks for them. They are
+# compiled by the layoutc host tool (layoutc/layoutc.pro), which is built
+# first, for the build machine when cross-compiling. LAYOUTC=<path> on
+# the qmake command line selects another build of it.
+isEmpty(LAYOUTC): LAYOUTC = $$shadowed($$PWD)/layoutc/layoutc
+win32 {
+  CONFIG(debug, debug|release): TARGET_DIR = $$OUT_PWD/debug
+  else: TARGET_DIR = $$OUT_PWD/release
+} else {
+  TARGET_DIR = $$OUT_PWD
+}
+!isEmpty(DESTDIR): TARGET_DIR = $$DESTDIR
+LAYOUT_SOURCES = $$files($$PWD/layouts/*.txt)
+layout_pack.name = layoutc ${QMAKE_FILE_IN}
+layout_pack.input = LAYOUT_SOURCES
+layout_pack.output = $$TARGET_DIR/layouts/${QMAKE_FILE_BASE}.sklp
+layout_pack.commands = $$shell_path($$LAYOUTC) ${QMAKE_FILE_IN} ${QMAKE_FILE_OUT}
+layout_pack.CONFIG += no_link target_predeps
+QMAKE_EXTRA_COMPILERS += layout_pack
@@ -0,0 +1,31 @@
+TEMPLATE = app
+TARGET = benchmarks
+INCLUDEPATH += . ..
+QT += testlib concurrent
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+DEFINES += QT_DEPRECATED_WARNINGS
+HEADERS += \
+        ../trace.hpp \
+        ../scancodemap.hpp \
+        ../keymap.hpp \
+        ../keymaphash.hpp \
+        ../keymapanalyzer.hpp \
+        ../keymapexport.hpp \
+        ../keystrokesimulator.hpp \
+        ../profilelibrary.hpp \
+        ../profilestore.hpp \
+        ../keyboarddefs.hpp \
+        ../layoutpack.hpp
+SOURCES += \
+        tst_benchmarks.cpp \
+        ../trace.cpp \
+        ../scancodemap.cpp \
+        ../keymaphash.cpp \
+        ../keymapanalyzer.cpp \
+        ../keymapexport.cpp \
+        ../keystrokesimulator.cpp \
+        ../profilelibrary.cpp \
+        ../profilestore.cpp \
+        ../keyboarddefs.cpp \
+        ../layoutpack.cpp
@@ -0,0 +1,217 @@
+#include <memory>
+#include <vector>
+
+#include <QBuffer>
+#include <QDir>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include "keyboarddefs.hpp"
+#include "keymapanalyzer.hpp"
+#include "keymapexport.hpp"
+#include "keymaphash.hpp"
+#include "keystrokesimulator.hpp"
+#include "profilelibrary.hpp"
+#include "profilestore.hpp"
+#include "scancodemap.hpp"
+
+namespace {
+
+const quint32 kSeed = 20200411;
+const int kDefaultProfileCount = 1000;
+const int kEntryCount = 64;
+const int kKeyStrokeCount = 1 << 20;
+
+// Keeps results alive so that the compiler can't drop benchmarked calls
+volatile quint64 sink;
+
+QList<KeyMapEntry> generateKeyMap(KeyboardType keyboard_type, int entry_count,
+                                  QRandomGenerator* random) {
+  auto key_names = getKeyNames(keyboard_type);
+  QList<KeyMapEntry> key_map;
+  for (int idx = 0; idx < entry_count; ++ idx) {
+    auto actual_key = getScanCodeOf(keyboard_type, key_names[random->bounded(key_names.count())]);
+    auto map_to_key = getScanCodeOf(keyboard_type, key_names[random->bounded(key_names.count())]);
+    key_map.append({actual_key, map_to_key});
+  }
+  return key_map;
+}
+
+}  // namespace
+
+// Microbenchmarks of the core paths, for catching performance regressions.
+// Inputs are generated from a fixed seed, so runs are comparable between
+// builds. SETKEYMAP_BENCHMARK_PROFILES sets the number of key maps of the
+// profile library cases. Results are written in a machine-readable form
+// by the QTest output options, e.g. "benchmarks -o results.xml,xml".
+class CoreBenchmarks : public QObject {
+  Q_OBJECT
+ private slots:
+  void initTestCase();
+  void keyboardDefsGetKeyNameOf();
+  void keyboardDefsGetScanCodeOf();
+  void scancodeMapEncode();
+  void scancodeMapDecode();
+  void scancodeMapEncodeToHexString();
+  void keyMapHash();
+  void keyMapAnalysis();
+  void profileLibraryOpen();
+  void profileStoreLoad();
+  void profileStoreFindNameOf();
+  void keyStrokeSimulation();
+  void exportHex();
+  void exportReg();
+  void exportJson();
+
+ private:
+  void exportKeyMaps_(ExportFormat format);
+
+  KeyboardType keyboard_type_ = KeyboardType::kUS;
+  QStringList key_names_;
+  std::vector<uint16_t> scan_codes_;
+  QList<KeyMapEntry> key_map_;
+  QByteArray scancode_map_;
+  QTemporaryDir temp_dir_;
+  QString library_path_;
+  // The last key map of the library, as the worst case of a linear search
+  QList<KeyMapEntry> last_key_map_;
+  std::unique_ptr<ProfileStore> profile_store_;
+  std::vector<uint16_t> keystrokes_;
+  std::unique_ptr<KeyStrokeSimulator> simulator_;
+};
+
+void CoreBenchmarks::initTestCase() {
+  bool ok = false;
+  auto profile_count = qEnvironmentVariableIntValue("SETKEYMAP_BENCHMARK_PROFILES", &ok);
+  if (!ok || profile_count <= 0) {
+    profile_count = kDefaultProfileCount;
+  }
+  QRandomGenerator random(kSeed);
+  key_names_ = getKeyNames(keyboard_type_);
+  for (auto& key_name : key_names_) {
+    scan_codes_.push_back(getScanCodeOf(keyboard_type_, key_name));
+  }
+  key_map_ = generateKeyMap(keyboard_type_, kEntryCount, &random);
+  scancode_map_ = encodeScancodeMap(key_map_);
+
+  QVERIFY(temp_dir_.isValid());
+  library_path_ = QDir(temp_dir_.path()).filePath("benchmark.skml");
+  QList<PackedKeyMap> packed_key_maps;
+  for (int idx = 0; idx < profile_count; ++ idx) {
+    last_key_map_ = generateKeyMap(keyboard_type_, kEntryCount, &random);
+    packed_key_maps.append({QString("profile%1").arg(idx), keyboard_type_,
+                            encodeKeyMapEntries(last_key_map_), getKeyMapHash(last_key_map_)});
+  }
+  QCOMPARE(writeProfileLibrary(library_path_, packed_key_maps), QString());
+  profile_store_.reset(new ProfileStore(library_path_));
+
+  keystrokes_.resize(kKeyStrokeCount);
+  for (auto& keystroke : keystrokes_) {
+    keystroke = scan_codes_[random.bounded(static_cast<int>(scan_codes_.size()))];
+  }
+  simulator_.reset(new KeyStrokeSimulator(key_map_));
+}
+
+void CoreBenchmarks::keyboardDefsGetKeyNameOf() {
+  QBENCHMARK {
+    for (auto scan_code : scan_codes_) {
+      sink = sink + getKeyNameOf(keyboard_type_, scan_code).size();
+    }
+  }
+}
+
+void CoreBenchmarks::keyboardDefsGetScanCodeOf() {
+  QBENCHMARK {
+    for (auto& key_name : key_names_) {
+      sink = sink + getScanCodeOf(keyboard_type_, key_name);
+    }
+  }
+}
+
+void CoreBenchmarks::scancodeMapEncode() {
+  QBENCHMARK {
+    sink = sink + encodeScancodeMap(key_map_).size();
+  }
+}
+
+void CoreBenchmarks::scancodeMapDecode() {
+  QBENCHMARK {
+    QList<KeyMapEntry> decoded;
+    decodeScancodeMap(scancode_map_, &decoded);
+    sink = sink + decoded.count();
+  }
+}
+
+void CoreBenchmarks::scancodeMapEncodeToHexString() {
+  QBENCHMARK {
+    sink = sink + encodeToHexString(scancode_map_).size();
+  }
+}
+
+void CoreBenchmarks::keyMapHash() {
+  QBENCHMARK {
+    sink = sink + getKeyMapHash(key_map_);
+  }
+}
+
+void CoreBenchmarks::keyMapAnalysis() {
+  QBENCHMARK {
+    sink = sink + analyzeKeyMap(keyboard_type_, key_map_).warning_count;
+  }
+}
+
+void CoreBenchmarks::profileLibraryOpen() {
+  QBENCHMARK {
+    ProfileLibrary library;
+    library.open(library_path_);
+    sink = sink + library.count();
+  }
+}
+
+void CoreBenchmarks::profileStoreLoad() {
+  QBENCHMARK {
+    ProfileStore profile_store(library_path_);
+    sink = sink + profile_store.count();
+  }
+}
+
+void CoreBenchmarks::profileStoreFindNameOf() {
+  QBENCHMARK {
+    sink = sink + profile_store_->findNameOf(last_key_map_).size();
+  }
+}
+
+void CoreBenchmarks::keyStrokeSimulation() {
+  QBENCHMARK {
+    sink = sink + simulateKeyStrokes(*simulator_, keystrokes_.data(), kKeyStrokeCount)
+        .remapped_count;
+  }
+}
+
+void CoreBenchmarks::exportHex() {
+  exportKeyMaps_(ExportFormat::kHex);
+}
+
+void CoreBenchmarks::exportReg() {
+  exportKeyMaps_(ExportFormat::kReg);
+}
+
+void CoreBenchmarks::exportJson() {
+  exportKeyMaps_(ExportFormat::kJson);
+}
+
+void CoreBenchmarks::exportKeyMaps_(ExportFormat format) {
+  // Exports are written over the same buffer, so that only formatting is
+  // measured
+  QBuffer buffer;
+  buffer.open(QIODevice::WriteOnly);
+  QBENCHMARK {
+    buffer.seek(0);
+    exportKeyMaps(profile_store_->getPackedKeyMaps(), format, &buffer);
+    sink = sink + buffer.pos();
+  }
+}
+
+QTEST_GUILESS_MAIN(CoreBenchmarks)
+#include "tst_benchmarks.moc"
@@ -0,0 +1,43 @@
+# Console build of the command line mode. It links neither QtGui nor
+# QtWidgets, and is deployed next to SetKeyMap, whose profile file it
+# uses.
+TEMPLATE = app
+TARGET = SetKeyMapCli
+INCLUDEPATH += . ..
+QT -= gui
+QT += concurrent
+CONFIG += c++17 console
+CONFIG -= app_bundle
+DEFINES += QT_DEPRECATED_WARNINGS
+HEADERS += \
+        ../winutil.hpp \
+        ../trace.hpp \
+        ../scancodemap.hpp \
+        ../scancodemapstore.hpp \
+        ../keymap.hpp \
+        ../keymaphash.hpp \
+        ../keymapanalyzer.hpp \
+        ../keymapexport.hpp \
+        ../keymapimport.hpp \
+        ../keystrokesimulator.hpp \
+        ../profilelibrary.hpp \
+        ../profilestore.hpp \
+        ../commandline.hpp \
+        ../keyboarddefs.hpp \
+        ../layoutpack.hpp
+SOURCES += \
+        main.cpp \
+        ../winutil.cpp \
+        ../trace.cpp \
+        ../scancodemap.cpp \
+        ../scancodemapstore.cpp \
+        ../keymaphash.cpp \
+        ../keymapanalyzer.cpp \
+        ../keymapexport.cpp \
+        ../keymapimport.cpp \
+        ../keystrokesimulator.cpp \
+        ../profilelibrary.cpp \
+        ../profilestore.cpp \
+        ../commandline.cpp \
+        ../keyboarddefs.cpp \
+        ../layoutpack.cpp
@@ -0,0 +1,17 @@
+//
+// Console program of SetKeyMap, which runs the command line mode without
+// QtWidgets
+//
+
+#include <QCoreApplication>
+
+#include "commandline.hpp"
+#include "trace.hpp"
+
+int main(int argc, char* argv[]) {
+  initTracing(&argc, argv);
+  TraceSpan span("main");
+  QCoreApplication::setOrganizationName("SetKeyMap");
+  QCoreApplication::setApplicationName("SetKeyMap");
+  return runCommandLine(argc, argv);
+}
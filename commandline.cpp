@@ -0,0 +1,353 @@
+#include "commandline.hpp"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QTextStream>
+
+#include "keymapexport.hpp"
+#include "keymaphash.hpp"
+#include "keymapimport.hpp"
+#include "keystrokesimulator.hpp"
+#include "layoutpack.hpp"
+#include "profilelibrary.hpp"
+#include "profilestore.hpp"
+#include "winutil.hpp"
+
+namespace {
+
+const char* const kCommandOptions[] = {
+  "--list", "--apply", "--export", "--export-all", "--verify", "--duplicates",
+  "--import", "--import-library", "--export-library", "--simulate", "--compile-layout", "--help"
+};
+
+QStringList readNames(const QString& name_arg) {
+  if (name_arg != "-") {
+    return {name_arg};
+  }
+  QStringList names;
+  QTextStream in(stdin);
+  while (!in.atEnd()) {
+    auto name = in.readLine().trimmed();
+    if (!name.isEmpty()) {
+      names.append(name);
+    }
+  }
+  return names;
+}
+
+int listKeyMaps(const ProfileStore& profile_store, QTextStream& out) {
+  auto current_name = profile_store.findNameOf(loadKeyMap());
+  for (auto& name : profile_store.getNames()) {
+    out << (name == current_name ? "* " : "  ") << name << "\n";
+  }
+  return 0;
+}
+
+int applyKeyMap(const ProfileStore& profile_store, const QStringList& names,
+                QTextStream& out, QTextStream& err) {
+  if (names.count() != 1) {
+    err << "Exactly one key map can be applied\n";
+    return 1;
+  }
+  auto idx = profile_store.indexOf(names.front());
+  if (idx < 0) {
+    err << QString("Unknown key map '%1'\n").arg(names.front());
+    return 1;
+  }
+  if (!hasAdminPrivilege()) {
+    err << "Applying a key map needs admin privilege. "
+           "Run the command from an elevated command prompt.\n";
+    return 1;
+  }
+  auto err_msg = setKeyMap(profile_store.getKeyMap(idx).key_map);
+  if (!err_msg.isEmpty()) {
+    err << err_msg << "\n";
+    return 1;
+  }
+  out << QString("Key map has been updated to '%1'\n").arg(names.front());
+  return 0;
+}
+
+int exportKeyMaps(const ProfileStore& profile_store, const QStringList& names,
+                  QTextStream& out, QTextStream& err) {
+  int exit_code = 0;
+  for (auto& name : names) {
+    auto idx = profile_store.indexOf(name);
+    if (idx < 0) {
+      err << QString("Unknown key map '%1'\n").arg(name);
+      exit_code = 1;
+      continue;
+    }
+    out << "[" << name << "]\n"
+        << encodeToHexString(encodeScancodeMap(profile_store.getKeyMap(idx).key_map)) << "\n";
+  }
+  return exit_code;
+}
+
+int exportAllKeyMaps(const ProfileStore& profile_store, const QString& file_path,
+                     QTextStream& out, QTextStream& err) {
+  auto err_msg = exportKeyMaps(profile_store.getPackedKeyMaps(),
+                               getExportFormatOf(file_path), file_path);
+  if (!err_msg.isEmpty()) {
+    err << err_msg << "\n";
+    return 1;
+  }
+  out << QString("%1 key maps have been exported\n").arg(profile_store.count());
+  return 0;
+}
+
+int verifyKeyMaps(const ProfileStore& profile_store, const QStringList& names,
+                  QTextStream& out, QTextStream& err) {
+  auto current_key_map = getCanonicalKeyMap(loadKeyMap());
+  int exit_code = 1;
+  for (auto& name : names) {
+    auto idx = profile_store.indexOf(name);
+    if (idx < 0) {
+      err << QString("Unknown key map '%1'\n").arg(name);
+      continue;
+    }
+    bool applied = getCanonicalKeyMap(profile_store.getKeyMap(idx).key_map) == current_key_map;
+    out << name << (applied ? ": applied\n" : ": not applied\n");
+    if (applied) {
+      exit_code = 0;
+    }
+  }
+  return exit_code;
+}
+
+int listDuplicates(const ProfileStore& profile_store, QTextStream& out) {
+  for (auto& names : profile_store.findDuplicates()) {
+    out << names.join(", ") << "\n";
+  }
+  return 0;
+}
+
+int importKeyMaps(ProfileStore& profile_store, const QString& dir_path,
+                  const QString& keyboard_type_str, QTextStream& out, QTextStream& err) {
+  if (!QFileInfo(dir_path).isDir()) {
+    err << QString("'%1' is not a directory\n").arg(dir_path);
+    return 1;
+  }
+  if (!getKeyboardTypeNames().contains(keyboard_type_str)) {
+    err << QString("Unknown keyboard type '%1'\n").arg(keyboard_type_str);
+    return 1;
+  }
+  auto results = parseImportFiles(findImportFiles(dir_path),
+                                  getKeyboardTypeFromString(keyboard_type_str)).results();
+  auto plan = planImport(results, profile_store);
+  auto details = describeImportDetails(plan);
+  if (!details.isEmpty()) {
+    err << details << "\n";
+  }
+  out << describeImportPlan(plan) << "\n";
+  // All or nothing, so that a failed import can be fixed and run again
+  if (!plan.conflicts.isEmpty() || !plan.errors.isEmpty()) {
+    err << "Nothing has been imported\n";
+    return 1;
+  }
+  profile_store.setKeyMaps(plan.key_maps);
+  auto err_msg = profile_store.flush();
+  if (!err_msg.isEmpty()) {
+    err << err_msg << "\n";
+    return 1;
+  }
+  return 0;
+}
+
+int importLibrary(ProfileStore& profile_store, const QString& library_path,
+                  QTextStream& out, QTextStream& err) {
+  ProfileLibrary library;
+  auto err_msg = library.open(library_path);
+  if (!err_msg.isEmpty()) {
+    err << err_msg << "\n";
+    return 1;
+  }
+  for (int idx = 0; idx < library.count(); ++ idx) {
+    profile_store.setKeyMap({library.getName(idx), library.getKeyboardType(idx),
+                             library.getKeyMap(idx)});
+  }
+  err_msg = profile_store.flush();
+  if (!err_msg.isEmpty()) {
+    err << err_msg << "\n";
+    return 1;
+  }
+  out << QString("%1 key maps have been imported\n").arg(library.count());
+  return 0;
+}
+
+int exportLibrary(const ProfileStore& profile_store, const QString& library_path,
+                  QTextStream& out, QTextStream& err) {
+  auto err_msg = writeProfileLibrary(library_path, profile_store.getPackedKeyMaps());
+  if (!err_msg.isEmpty()) {
+    err << err_msg << "\n";
+    return 1;
+  }
+  out << QString("%1 key maps have been exported\n").arg(profile_store.count());
+  return 0;
+}
+
+int simulateStream(const ProfileStore& profile_store, const QStringList& names,
+                   const QString& stream_path, const QString& expected_path,
+                   QTextStream& out, QTextStream& err) {
+  KeyStrokeStream stream;
+  auto err_msg = stream.open(stream_path);
+  if (!err_msg.isEmpty()) {
+    err << err_msg << "\n";
+    return 1;
+  }
+  KeyStrokeStream expected;
+  if (!expected_path.isEmpty()) {
+    err_msg = expected.open(expected_path);
+    if (!err_msg.isEmpty()) {
+      err << err_msg << "\n";
+      return 1;
+    }
+    if (expected.count() != stream.count()) {
+      err << "The expected stream differs in length from the keystroke stream\n";
+      return 1;
+    }
+  }
+  int exit_code = 0;
+  for (auto& name : names.isEmpty() ? profile_store.getNames() : names) {
+    auto idx = profile_store.indexOf(name);
+    if (idx < 0) {
+      err << QString("Unknown key map '%1'\n").arg(name);
+      exit_code = 1;
+      continue;
+    }
+    KeyStrokeSimulator simulator(profile_store.getKeyMap(idx).key_map);
+    auto stats = simulateKeyStrokes(simulator, stream.getData(), stream.count(),
+                                    expected.getData());
+    out << QString("%1: %2 keystrokes, %3 remapped")
+        .arg(name).arg(stats.keystroke_count).arg(stats.remapped_count);
+    if (!expected_path.isEmpty()) {
+      if (stats.mismatch_count > 0) {
+        out << QString(", %1 mismatched (first at %2)")
+            .arg(stats.mismatch_count).arg(stats.first_mismatch);
+        exit_code = 1;
+      } else {
+        out << ", matched";
+      }
+    }
+    out << "\n";
+  }
+  return exit_code;
+}
+
+int compileLayout(const QString& source_path, QTextStream& out, QTextStream& err) {
+  QFileInfo source_info(source_path);
+  auto pack_path = source_info.dir().filePath(source_info.completeBaseName() + ".sklp");
+  auto err_msg = compileLayoutPack(source_path, pack_path);
+  if (!err_msg.isEmpty()) {
+    err << err_msg << "\n";
+    return 1;
+  }
+  out << QString("Layout pack has been written to '%1'\n").arg(pack_path);
+  return 0;
+}
+
+}  // namespace
+
+bool isCommandLineMode(int argc, char* argv[]) {
+  for (int idx = 1; idx < argc; ++ idx) {
+    auto arg = QString::fromLocal8Bit(argv[idx]);
+    for (auto option : kCommandOptions) {
+      if (arg == option || arg.startsWith(QString(option) + "=")) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+int runCommandLine(int argc, char* argv[]) {
+  QCoreApplication app(argc, argv);
+  attachToParentConsole();
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Simple key map setup tool for windows (Scancode map)");
+  parser.addHelpOption();
+  QCommandLineOption list_option("list", "Lists saved key maps, '*' marks the applied one.");
+  QCommandLineOption apply_option("apply", "Applies the key map.", "name");
+  QCommandLineOption export_option("export", "Prints the Scancode Map of the key maps as hex.", "name");
+  QCommandLineOption export_all_option(
+      "export-all", "Writes all the key maps as .reg, .json, or hex for other suffixes.", "file");
+  QCommandLineOption verify_option("verify", "Succeeds if one of the key maps is the applied one.", "name");
+  QCommandLineOption duplicates_option(
+      "duplicates", "Lists groups of key maps which have the same effect.");
+  QCommandLineOption import_option(
+      "import", "Adds the key maps of the .reg, hex and .ini files under the directory. "
+      "Adds none and fails if any file has an error or a name conflict. "
+      ".txt files which aren't hex dumps are skipped.", "dir");
+  QCommandLineOption keyboard_type_option(
+      "keyboard-type", "Keyboard type of imported key maps which don't specify one.",
+      "type", "US");
+  QCommandLineOption import_library_option(
+      "import-library", "Adds the key maps of a profile library to the saved ones.", "file");
+  QCommandLineOption export_library_option(
+      "export-library", "Writes the saved key maps as a profile library.", "file");
+  QCommandLineOption simulate_option(
+      "simulate", "Replays a keystroke stream through the key maps.", "file");
+  QCommandLineOption expect_option(
+      "expect", "Expected output of --simulate. Succeeds if every key map matches it.", "file");
+  QCommandLineOption compile_layout_option(
+      "compile-layout", "Compiles a layout source into a layout pack next to it.", "file");
+  QList<QCommandLineOption> command_options = {
+    list_option, apply_option, export_option, export_all_option, verify_option, duplicates_option,
+    import_option, import_library_option, export_library_option, simulate_option, compile_layout_option
+  };
+  parser.addOptions(command_options);
+  parser.addOption(expect_option);
+  parser.addOption(keyboard_type_option);
+  parser.addPositionalArgument("names", "Key maps to simulate, '-' reads them from stdin.",
+                               "[names...]");
+  parser.process(app);
+
+  QTextStream out(stdout);
+  QTextStream err(stderr);
+  int command_count = 0;
+  for (auto& option : command_options) {
+    command_count += parser.isSet(option);
+  }
+  if (command_count != 1) {
+    err << "Specify exactly one command\n";
+    return 1;
+  }
+
+  if (parser.isSet(compile_layout_option)) {
+    return compileLayout(parser.value(compile_layout_option), out, err);
+  }
+
+  ProfileStore profile_store;
+  if (!profile_store.getLoadError().isEmpty()) {
+    err << profile_store.getLoadError() << "\n";
+    return 1;
+  }
+  if (parser.isSet(list_option)) {
+    return listKeyMaps(profile_store, out);
+  } else if (parser.isSet(apply_option)) {
+    return applyKeyMap(profile_store, readNames(parser.value(apply_option)), out, err);
+  } else if (parser.isSet(export_option)) {
+    return exportKeyMaps(profile_store, readNames(parser.value(export_option)), out, err);
+  } else if (parser.isSet(export_all_option)) {
+    return exportAllKeyMaps(profile_store, parser.value(export_all_option), out, err);
+  } else if (parser.isSet(verify_option)) {
+    return verifyKeyMaps(profile_store, readNames(parser.value(verify_option)), out, err);
+  } else if (parser.isSet(duplicates_option)) {
+    return listDuplicates(profile_store, out);
+  } else if (parser.isSet(import_option)) {
+    return importKeyMaps(profile_store, parser.value(import_option),
+                         parser.value(keyboard_type_option), out, err);
+  } else if (parser.isSet(import_library_option)) {
+    return importLibrary(profile_store, parser.value(import_library_option), out, err);
+  } else if (parser.isSet(simulate_option)) {
+    QStringList names;
+    for (auto& name_arg : parser.positionalArguments()) {
+      names.append(readNames(name_arg));
+    }
+    return simulateStream(profile_store, names, parser.value(simulate_option),
+                          parser.value(expect_option), out, err);
+  } else {
+    return exportLibrary(profile_store, parser.value(export_library_option), out, err);
+  }
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+// Headless mode for provisioning scripts. It runs on QCoreApplication
+// and never creates a widget. SetKeyMap runs it for these options, and
+// SetKeyMapCli (cli/cli.pro) always, without loading QtWidgets.
+//   --list                   Lists saved key maps, '*' marks the applied one
+//   --apply <name>           Applies the key map
+//   --export <name>          Prints the Scancode Map of the key map as hex
+//   --verify <name>          Succeeds if the key map is the applied one
+//   --duplicates             Lists groups of key maps with the same effect
+//   --import-library <file>  Adds the key maps of a profile library
+//   --export-library <file>  Writes the saved key maps as a profile library
+//   --simulate <file>        Replays a keystroke stream through the key maps
+//                            given as arguments, or all of them. With
+//                            --expect <file>, succeeds if every output
+//                            matches the expected stream.
+//   --compile-layout <file>  Compiles a layout source into a layout pack
+//                            next to it, e.g. DE.txt into DE.sklp
+// '-' as name reads key map names from stdin, one per line.
+
+// Returns true if the arguments select the command line mode
+bool isCommandLineMode(int argc, char* argv[]);
+
+// Returns exit code
+int runCommandLine(int argc, char* argv[]);
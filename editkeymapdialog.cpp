@@ -1,21 +1,53 @@
 #include "editkeymapdialog.hpp"
 
+#include <climits>
+#include <functional>
+
 #include <QVBoxLayout>
 #include <QHBoxLayout>
+#include <QFileDialog>
 #include <QHeaderView>
-#include <QLabel>
-#include <QSignalBlocker>
+#include <QMessageBox>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QtConcurrent>
+#include <QtEndian>
+
+#include "keyselectdelegate.hpp"
+#include "trace.hpp"
 
 namespace {
 
-QComboBox* createKeySelect(KeyboardType keyboard_type) {
-  auto key_select = new QComboBox;
-  for (auto& key_name : getKeyNames(keyboard_type)) {
-    uint32_t scan_code = getScanCodeOf(keyboard_type, key_name);
-    key_select->addItem(key_name, scan_code);
+const int kUndoLimit = 1000;
+
+// Switches between two snapshots. The change itself has been made when
+// the command is pushed, so the first redo does nothing.
+class KeyMapEditCommand : public QUndoCommand {
+ public:
+  KeyMapEditCommand(const QString& text, const KeyMapEditState& before,
+                    const KeyMapEditState& after,
+                    const std::function<void(const KeyMapEditState&)>& restore)
+      : QUndoCommand(text),
+        before_(before),
+        after_(after),
+        restore_(restore) {
   }
-  return key_select;
-}
+  void undo() override {
+    restore_(before_);
+  }
+  void redo() override {
+    if (pushed_) {
+      restore_(after_);
+    }
+    pushed_ = true;
+  }
+
+ private:
+  KeyMapEditState before_;
+  KeyMapEditState after_;
+  std::function<void(const KeyMapEditState&)> restore_;
+  bool pushed_ = false;
+};
 
 QLabel* createHeaderWidget(const QString& text) {
   auto header = new QLabel(QString("<h3>%1</h3>").arg(text));
@@ -27,22 +59,41 @@ QLabel* createHeaderWidget(const QString& text) {
   return header;
 }
 
-QString encodeToString(uint16_t value) {
-  auto lower = QString::number((value >> 0) & 0xFF, 16).toUpper();
-  if (lower.count() == 1) {
-    lower = "0" + lower;
-  }
-  auto upper = QString::number((value >> 8) & 0xFF, 16).toUpper();
-  if (upper.count() == 1) {
-    upper = "0" + upper;
-  }
-  return QString("%1 %2").arg(lower).arg(upper);
+// The scan code view shows the Scancode Map as 4-byte words, two per
+// line: header, header / count, entry / entry, ... , terminator.
+const int kWordsPerLine = 2;
+const int kCountLine = 1;
+const int kFirstEntryWord = 3;
+
+int getWordCount(int entry_count) {
+  return getScancodeMapSize(entry_count) / 4;
 }
 
-QString encodeToString(uint32_t value) {
-  return QString("%1 %2")
-      .arg(encodeToString(static_cast<uint16_t>((value >> 0) & 0xFFFF)))
-      .arg(encodeToString(static_cast<uint16_t>((value >> 16) & 0xFFFF)));
+int getLineCount(int entry_count) {
+  return (getWordCount(entry_count) + kWordsPerLine - 1) / kWordsPerLine;
+}
+
+int getLineOfRow(int row) {
+  return (kFirstEntryWord + row) / kWordsPerLine;
+}
+
+QString getScanCodeLine(const QList<KeyMapEntry>& key_map, int line) {
+  QByteArray line_bytes;
+  auto word_count = getWordCount(key_map.count());
+  for (int word_idx = line * kWordsPerLine;
+       word_idx < (line + 1) * kWordsPerLine && word_idx < word_count; ++ word_idx) {
+    quint32 word = 0;
+    auto row = word_idx - kFirstEntryWord;
+    if (word_idx == kFirstEntryWord - 1) {
+      word = key_map.count() + 1;
+    } else if (row >= 0 && row < key_map.count()) {
+      word = key_map[row].map_to_key | (static_cast<quint32>(key_map[row].actual_key) << 16);
+    }
+    char word_bytes[4];
+    qToLittleEndian<quint32>(word, word_bytes);
+    line_bytes.append(word_bytes, sizeof(word_bytes));
+  }
+  return encodeToHexString(line_bytes);
 }
 
 }  // namespace
@@ -62,24 +113,46 @@ EditKeyMapDialog::EditKeyMapDialog(QWidget* parent,
   initWidgetValues_();
   createConnections_();
   updateWindowState_();
+  last_state_ = getEditState_();
   resize(700, 600);
 }
 
+EditKeyMapDialog::~EditKeyMapDialog() {
+  // The simulation reads the stream which is closed here
+  simulation_watcher_.waitForFinished();
+}
+
 void EditKeyMapDialog::createWidgets_() {
   name_input_ = new QLineEdit;
   keyboard_type_select_ = new QComboBox;
-  keyboard_type_select_->addItems({
-      getStringOfKeyboardType(KeyboardType::kUS),
-      getStringOfKeyboardType(KeyboardType::kJP)});
+  keyboard_type_select_->addItems(getKeyboardTypeNames());
   add_entry_button_ = new QPushButton("Add entry");
   delete_checked_button_ = new QPushButton("Delete checked");
   load_current_scan_code_map_button_ = new QPushButton("Load current scancode map");
-  key_map_table_ = new QTableWidget;
-  key_map_table_->setColumnCount(3);
-  key_map_table_->setColumnWidth(0, 30);
-  key_map_table_->setColumnWidth(1, 200);
-  key_map_table_->setHorizontalHeaderLabels({"", "Actual key", "Map to key"});
+  simulate_button_ = new QPushButton("Simulate keystrokes...");
+  undo_stack_ = new QUndoStack(this);
+  undo_stack_->setUndoLimit(kUndoLimit);
+  auto undo_action = undo_stack_->createUndoAction(this);
+  undo_action->setShortcut(QKeySequence::Undo);
+  auto redo_action = undo_stack_->createRedoAction(this);
+  redo_action->setShortcut(QKeySequence::Redo);
+  addActions({undo_action, redo_action});
+  undo_button_ = new QToolButton;
+  undo_button_->setDefaultAction(undo_action);
+  redo_button_ = new QToolButton;
+  redo_button_->setDefaultAction(redo_action);
+  key_map_model_ = new KeyMapTableModel(this);
+  key_map_table_ = new QTableView;
+  key_map_table_->setModel(key_map_model_);
+  auto key_select_delegate = new KeySelectDelegate(&key_name_index_, this);
+  key_map_table_->setItemDelegateForColumn(KeyMapTableModel::kActualKeyColumn, key_select_delegate);
+  key_map_table_->setItemDelegateForColumn(KeyMapTableModel::kMapToKeyColumn, key_select_delegate);
+  key_map_table_->setEditTriggers(QAbstractItemView::AllEditTriggers);
+  key_map_table_->setSelectionMode(QAbstractItemView::NoSelection);
+  key_map_table_->setColumnWidth(KeyMapTableModel::kCheckColumn, 30);
+  key_map_table_->setColumnWidth(KeyMapTableModel::kActualKeyColumn, 200);
   key_map_table_->horizontalHeader()->setStretchLastSection(true);
+  analysis_label_ = new QLabel;
   scan_code_display_ = new QTextEdit;
   scan_code_display_->setReadOnly(true);
   auto font = scan_code_display_->font();
@@ -91,10 +164,13 @@ void EditKeyMapDialog::createWidgets_() {
   buttons_ = new  QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
   auto layout = new QVBoxLayout;
   auto button_layout = new QHBoxLayout;
+  button_layout->addWidget(undo_button_);
+  button_layout->addWidget(redo_button_);
   button_layout->addStretch(1);
   button_layout->addWidget(add_entry_button_);
   button_layout->addWidget(delete_checked_button_);
   button_layout->addWidget(load_current_scan_code_map_button_);
+  button_layout->addWidget(simulate_button_);
   layout->addWidget(createHeaderWidget("Setup name"));
   layout->addWidget(name_input_);
   layout->addWidget(createHeaderWidget("Keyboard type"));
@@ -102,6 +178,7 @@ void EditKeyMapDialog::createWidgets_() {
   layout->addWidget(createHeaderWidget("Key map table"));
   layout->addLayout(button_layout);
   layout->addWidget(key_map_table_);
+  layout->addWidget(analysis_label_);
   layout->addWidget(createHeaderWidget("Scan code"));
   layout->addWidget(scan_code_display_);
   layout->addWidget(buttons_);
@@ -109,6 +186,7 @@ void EditKeyMapDialog::createWidgets_() {
 }
 
 void EditKeyMapDialog::initWidgetValues_() {
+  TraceSpan span("EditKeyMapDialog::initWidgetValues_");
   if (!current_name_.isEmpty()) {
     name_input_->setText(current_name_);
     name_input_->setReadOnly(true);
@@ -116,165 +194,274 @@ void EditKeyMapDialog::initWidgetValues_() {
     pal.setColor(QPalette::Base, QColor("silver"));
     name_input_->setPalette(pal);
   }
-  setKeyMapTable_(current_keyboard_type_, current_key_map_);
+  setKeyMapTable_(current_keyboard_type_, PersistentKeyMap(current_key_map_));
 }
 
-QList<KeyMapEntry> EditKeyMapDialog::setKeyMapTable_(KeyboardType keyboard_type,
-                                                     const QList<KeyMapEntry>& key_map) {
-  QList<KeyMapEntry> updated_key_map;
+void EditKeyMapDialog::setKeyMapTable_(KeyboardType keyboard_type,
+                                       const PersistentKeyMap& key_map) {
+  TraceSpan span("EditKeyMapDialog::setKeyMapTable_");
   auto keyboard_type_name = getStringOfKeyboardType(keyboard_type);
   keyboard_type_select_->setCurrentIndex(keyboard_type_select_->findText(keyboard_type_name));
-  for (auto& key_map_entry : key_map) {
-    addMapEntry_();
-    auto row = key_map_table_->rowCount() - 1;
-
-    auto actual_key_name = getKeyNameOf(keyboard_type, key_map_entry.actual_key);
-    auto map_to_key_name = getKeyNameOf(keyboard_type, key_map_entry.map_to_key);
-    if (actual_key_name.isEmpty() || map_to_key_name.isEmpty()) {
-      // The key code is not supported in the specified keyboard type
-      // Ignore this entry
-      continue;
-    }
-    updated_key_map.append(key_map_entry);
-    auto actual_key_select = qobject_cast<QComboBox*>(key_map_table_->cellWidget(row, 1));
-    actual_key_select->setCurrentIndex(actual_key_select->findText(actual_key_name));
-
-    auto map_to_key_select = qobject_cast<QComboBox*>(key_map_table_->cellWidget(row, 2));
-    map_to_key_select->setCurrentIndex(map_to_key_select->findText(map_to_key_name));
-  }
-  return updated_key_map;
+  key_name_index_.setKeyboardType(keyboard_type);
+  // Entries which the keyboard type doesn't define are kept and flagged
+  // by the model
+  key_map_model_->setKeyMap(keyboard_type, key_map);
 }
 
 void EditKeyMapDialog::addMapEntry_() {
-  QSignalBlocker blocker(key_map_table_);
-  auto keyboard_type = getKeyboardType();
-  auto row = key_map_table_->rowCount();
-  key_map_table_->insertRow(row);
-  auto check_item = new QTableWidgetItem();
-  check_item->setFlags(Qt::ItemIsEnabled | Qt::ItemIsUserCheckable);
-  check_item->setCheckState(Qt::Unchecked);
-  key_map_table_->setItem(row, 0, check_item);
-
-  auto actual_key_item = new QTableWidgetItem();
-  actual_key_item->setFlags(Qt::NoItemFlags);
-  key_map_table_->setItem(row, 1, actual_key_item);
-  auto actual_key_select = createKeySelect(keyboard_type);
-  key_map_table_->setCellWidget(row, 1, actual_key_select);
-  connect(actual_key_select, qOverload<int>(&QComboBox::currentIndexChanged),
-          this, &EditKeyMapDialog::updateWindowState_);
-
-  auto map_to_key_item = new QTableWidgetItem();
-  map_to_key_item->setFlags(Qt::NoItemFlags);
-  key_map_table_->setItem(row, 2, map_to_key_item);
-  auto map_to_key_select = createKeySelect(keyboard_type);
-  key_map_table_->setCellWidget(row, 2, map_to_key_select);
-  connect(map_to_key_select, qOverload<int>(&QComboBox::currentIndexChanged),
-          this, &EditKeyMapDialog::updateWindowState_);
-
-  updateWindowState_();
+  // New entries start with the first key of the list, as a fresh combo
+  // box would show
+  if (key_name_index_.count() == 0) {
+    return;
+  }
+  auto first_scan_code = key_name_index_.getScanCodeAt(0);
+  key_map_model_->appendEntry({first_scan_code, first_scan_code});
+  pushEditState_("Add entry");
 }
 
 void EditKeyMapDialog::deleteChecked_() {
-  QSignalBlocker blocker(key_map_table_);
+  TraceSpan span("EditKeyMapDialog::deleteChecked_");
+  // Each removed run moves the rows after it, which are updated once
+  // from the lowest of them
+  entry_updates_suspended_ = true;
+  key_map_model_->removeCheckedEntries();
+  entry_updates_suspended_ = false;
+  if (first_moved_row_ != INT_MAX) {
+    updateEntriesFrom_(QModelIndex(), first_moved_row_);
+    first_moved_row_ = INT_MAX;
+  }
+  pushEditState_("Delete checked entries");
+}
 
-  QList<int> rows_to_be_removed;
-  for (int row = key_map_table_->rowCount() - 1; row >= 0; -- row) {
-    if (key_map_table_->item(row, 0)->checkState() == Qt::Checked) {
-      rows_to_be_removed.append(row);
-    }
+void EditKeyMapDialog::loadCurrentScancodeMap_() {
+  // The keyboard type select may switch on the way, which is not an edit
+  // of its own
+  undo_suspended_ = true;
+  setKeyMapTable_(getKeyboardType(), PersistentKeyMap(loadKeyMap()));
+  undo_suspended_ = false;
+  pushEditState_("Load current scancode map");
+}
+
+void EditKeyMapDialog::simulateKeyStrokes_() {
+  auto stream_path = QFileDialog::getOpenFileName(this, "Keystroke stream");
+  if (stream_path.isEmpty()) {
+    return;
   }
-  for (auto row : rows_to_be_removed) {
-    key_map_table_->removeCellWidget(row, 1);
-    key_map_table_->removeCellWidget(row, 2);
-    key_map_table_->removeRow(row);
+  auto stream = std::make_unique<KeyStrokeStream>();
+  auto err_msg = stream->open(stream_path);
+  if (!err_msg.isEmpty()) {
+    QMessageBox::warning(this, "Simulate keystrokes", err_msg);
+    return;
   }
-
-  updateWindowState_();
+  // Runs on worker threads, so that the dialog stays responsive with a
+  // large stream. The stream is kept open until the simulation finishes.
+  simulation_stream_ = std::move(stream);
+  simulate_button_->setEnabled(false);
+  auto data = simulation_stream_->getData();
+  auto count = simulation_stream_->count();
+  simulation_watcher_.setFuture(QtConcurrent::run(
+      [key_map = key_map_model_->getKeyMap(), data, count] {
+        TraceSpan span("EditKeyMapDialog::simulateKeyStrokes");
+        KeyStrokeSimulator simulator(key_map);
+        return simulateKeyStrokes(simulator, data, count);
+      }));
 }
 
-void EditKeyMapDialog::loadCurrentScancodeMap_() {
-  QSignalBlocker blocker(key_map_table_);
-  key_map_table_->setRowCount(0);
-  setKeyMapTable_(getKeyboardType(), loadKeyMap());
-  updateWindowState_();
+void EditKeyMapDialog::finishSimulation_() {
+  simulation_stream_.reset();
+  simulate_button_->setEnabled(true);
+  auto stats = simulation_watcher_.result();
+  QMessageBox::information(this, "Simulate keystrokes",
+                           QString("%1 of %2 keystrokes are remapped")
+                           .arg(stats.remapped_count).arg(stats.keystroke_count));
 }
 
 void EditKeyMapDialog::updateKeyboardType_() {
-  auto key_map = getKeyMap();
-  key_map_table_->setRowCount(0);
-  setKeyMapTable_(getKeyboardType(), key_map);
-  updateWindowState_();
+  TraceSpan span("EditKeyMapDialog::updateKeyboardType_");
+  // Scan codes don't depend on the keyboard type, so rows are only
+  // relabeled
+  auto keyboard_type = getKeyboardType();
+  key_name_index_.setKeyboardType(keyboard_type);
+  key_map_model_->setKeyboardType(keyboard_type);
+  updateAnalysis_();
+  updateButtonState_();
+  pushEditState_("Switch keyboard type");
 }
 
 void EditKeyMapDialog::updateWindowState_() {
-  // Delete button state
-  bool any_checked = false;
-  for (int row = 0; row < key_map_table_->rowCount(); ++ row) {
-    if (key_map_table_->item(row, 0)->checkState() == Qt::Checked) {
-      any_checked = true;
-      break;
-    }
+  TraceSpan span("EditKeyMapDialog::updateWindowState_");
+  updateDifferingRows_(0, INT_MAX);
+  scan_code_display_->clear();
+  updateScanCodeLines_(0, INT_MAX);
+  updateAnalysis_();
+  updateButtonState_();
+}
+
+void EditKeyMapDialog::updateEntries_(const QModelIndex& top_left,
+                                      const QModelIndex& bottom_right,
+                                      const QVector<int>& roles) {
+  TraceSpan span("EditKeyMapDialog::updateEntries_");
+  // Check states and relabeling don't change entries
+  if (bottom_right.column() >= KeyMapTableModel::kActualKeyColumn
+      && (roles.isEmpty() || roles.contains(Qt::EditRole))) {
+    updateDifferingRows_(top_left.row(), bottom_right.row());
+    updateScanCodeLines_(getLineOfRow(top_left.row()), getLineOfRow(bottom_right.row()));
+    updateAnalysis_();
+    pushEditState_("Change key");
   }
-  delete_checked_button_->setEnabled(any_checked);
+  updateButtonState_();
+}
 
-  // OK button state
-  auto keyboard_type = getKeyboardType();
-  QList<KeyMapEntry> key_map;
-  for (int row = 0; row < key_map_table_->rowCount(); ++ row) {
-    KeyMapEntry entry;
-    auto actual_key_select = qobject_cast<QComboBox*>(key_map_table_->cellWidget(row, 1));
-    entry.actual_key = actual_key_select->currentData().toUInt();
-    auto map_to_key_select = qobject_cast<QComboBox*>(key_map_table_->cellWidget(row, 2));
-    entry.map_to_key = map_to_key_select->currentData().toUInt();
-    key_map.append(entry);
+void EditKeyMapDialog::updateEntriesFrom_(const QModelIndex&, int first_row) {
+  if (entry_updates_suspended_) {
+    first_moved_row_ = qMin(first_moved_row_, first_row);
+    return;
   }
+  TraceSpan span("EditKeyMapDialog::updateEntriesFrom_");
+  // Rows after first_row have moved, and the entry count has changed
+  updateDifferingRows_(first_row, INT_MAX);
+  updateScanCodeLines_(kCountLine, kCountLine);
+  updateScanCodeLines_(getLineOfRow(first_row), INT_MAX);
+  updateAnalysis_();
+  updateButtonState_();
+}
+
+void EditKeyMapDialog::updateButtonState_() {
+  // Delete button state
+  delete_checked_button_->setEnabled(key_map_model_->hasCheckedEntry());
+
+  // OK button state
+  bool modified = differing_row_count_ > 0
+      || key_map_model_->rowCount() != current_key_map_.count()
+      || current_keyboard_type_ != getKeyboardType();
   auto ok_button = buttons_->button(QDialogButtonBox::Ok);
   ok_button->setEnabled(!name_input_->text().isEmpty()
                         && !existing_names_.contains(name_input_->text())
-                        && (current_key_map_ != key_map
-                            || current_keyboard_type_ != keyboard_type));
+                        && analysis_.error_count == 0
+                        && modified);
+}
+
+void EditKeyMapDialog::updateDifferingRows_(int first_row, int last_row) {
+  auto& key_map = key_map_model_->getKeyMap();
+  for (int row = first_row; row <= last_row && row < differing_rows_.count(); ++ row) {
+    if (differing_rows_[row]) {
+      -- differing_row_count_;
+    }
+  }
+  differing_rows_.resize(key_map.count());
+  for (int row = first_row; row <= last_row && row < key_map.count(); ++ row) {
+    differing_rows_[row] = row >= current_key_map_.count() || key_map[row] != current_key_map_[row];
+    if (differing_rows_[row]) {
+      ++ differing_row_count_;
+    }
+  }
+}
 
-  // Scan code text view
+void EditKeyMapDialog::updateScanCodeLines_(int first_line, int last_line) {
+  auto& key_map = key_map_model_->getKeyMap();
   if (key_map.isEmpty()) {
     scan_code_display_->clear();
-  } else {
-    QString scan_code_str = "00 00 00 00  00 00 00 00\n";
-    scan_code_str += encodeToString(static_cast<uint32_t>(key_map.count() + 1));
-    int key_idx = 1;
-    auto updateCurrentLineEnd = [&key_idx, &scan_code_str] () {
-      if (key_idx == 1) {
-        scan_code_str += "  ";
-        key_idx ++;
-      } else if (key_idx == 2) {
-        scan_code_str += "\n";
-        key_idx = 1;
-      }
-    };
-    for (auto& key_map_entry : key_map) {
-      updateCurrentLineEnd();
-      scan_code_str += encodeToString(key_map_entry.map_to_key);
-      scan_code_str += " ";
-      scan_code_str += encodeToString(key_map_entry.actual_key);
+    return;
+  }
+  auto line_count = getLineCount(key_map.count());
+  auto document = scan_code_display_->document();
+  if (document->isEmpty()) {
+    QStringList lines;
+    for (int line = 0; line < line_count; ++ line) {
+      lines.append(getScanCodeLine(key_map, line));
     }
-    updateCurrentLineEnd();
-    scan_code_str += "00 00 00 00"; // Footer
-    scan_code_display_->setPlainText(scan_code_str);
+    scan_code_display_->setPlainText(lines.join("\n"));
+    return;
+  }
+
+  // Replace only the given lines, and append or drop lines at the end
+  // when the entry count has changed
+  last_line = qMin(last_line, line_count - 1);
+  QTextCursor cursor(document);
+  cursor.beginEditBlock();
+  for (int line = first_line; line <= last_line; ++ line) {
+    auto block = document->findBlockByNumber(line);
+    if (block.isValid()) {
+      cursor.setPosition(block.position());
+      cursor.setPosition(block.position() + block.length() - 1, QTextCursor::KeepAnchor);
+      cursor.insertText(getScanCodeLine(key_map, line));
+    } else {
+      cursor.movePosition(QTextCursor::End);
+      cursor.insertText("\n" + getScanCodeLine(key_map, line));
+    }
+  }
+  auto last_block = document->findBlockByNumber(line_count - 1);
+  if (last_block.isValid() && last_block.next().isValid()) {
+    cursor.setPosition(last_block.position() + last_block.length() - 1);
+    cursor.movePosition(QTextCursor::End, QTextCursor::KeepAnchor);
+    cursor.removeSelectedText();
+  }
+  cursor.endEditBlock();
+}
+
+void EditKeyMapDialog::updateAnalysis_() {
+  TraceSpan span("EditKeyMapDialog::updateAnalysis_");
+  // The whole map is analyzed, as one entry can affect any other. Only
+  // rows whose issues have changed are repainted.
+  analysis_ = analyzeKeyMap(getKeyboardType(), key_map_model_->getKeyMap());
+  key_map_model_->setEntryIssues(analysis_.entry_issues);
+  if (analysis_.error_count == 0 && analysis_.warning_count == 0) {
+    analysis_label_->clear();
+  } else {
+    analysis_label_->setText(QString("%1 error(s), %2 warning(s). Hover a row for details.")
+                             .arg(analysis_.error_count).arg(analysis_.warning_count));
+  }
+}
+
+KeyMapEditState EditKeyMapDialog::getEditState_() const {
+  return {key_map_model_->getKeyboardType(), key_map_model_->getSnapshot()};
+}
+
+void EditKeyMapDialog::pushEditState_(const QString& text) {
+  if (undo_suspended_) {
+    return;
+  }
+  auto state = getEditState_();
+  if (state.keyboard_type == last_state_.keyboard_type
+      && state.key_map.isSameVersion(last_state_.key_map)) {
+    return;
   }
+  undo_stack_->push(new KeyMapEditCommand(text, last_state_, state, [this](auto& state) {
+    restoreEditState_(state);
+  }));
+  last_state_ = state;
+}
+
+void EditKeyMapDialog::restoreEditState_(const KeyMapEditState& state) {
+  undo_suspended_ = true;
+  setKeyMapTable_(state.keyboard_type, state.key_map);
+  undo_suspended_ = false;
+  last_state_ = state;
 }
 
 void EditKeyMapDialog::createConnections_() {
   connect(name_input_, &QLineEdit::textChanged,
-          this, &EditKeyMapDialog::updateWindowState_);
+          this, &EditKeyMapDialog::updateButtonState_);
   connect(keyboard_type_select_, qOverload<int>(&QComboBox::currentIndexChanged),
           this, &EditKeyMapDialog::updateKeyboardType_);
-  connect(key_map_table_, &QTableWidget::itemChanged,
-          this, &updateWindowState_);
+  connect(key_map_model_, &KeyMapTableModel::dataChanged,
+          this, &EditKeyMapDialog::updateEntries_);
+  connect(key_map_model_, &KeyMapTableModel::rowsInserted,
+          this, &EditKeyMapDialog::updateEntriesFrom_);
+  connect(key_map_model_, &KeyMapTableModel::rowsRemoved,
+          this, &EditKeyMapDialog::updateEntriesFrom_);
+  connect(key_map_model_, &KeyMapTableModel::modelReset,
+          this, &EditKeyMapDialog::updateWindowState_);
   connect(add_entry_button_, &QPushButton::clicked,
           this, &EditKeyMapDialog::addMapEntry_);
   connect(delete_checked_button_, &QPushButton::clicked,
           this, &EditKeyMapDialog::deleteChecked_);
   connect(load_current_scan_code_map_button_, &QPushButton::clicked,
           this, &EditKeyMapDialog::loadCurrentScancodeMap_);
+  connect(simulate_button_, &QPushButton::clicked,
+          this, &EditKeyMapDialog::simulateKeyStrokes_);
+  connect(&simulation_watcher_, &QFutureWatcher<KeyStrokeStats>::finished,
+          this, &EditKeyMapDialog::finishSimulation_);
   connect(buttons_, &QDialogButtonBox::accepted,
           this, &EditKeyMapDialog::accept);
   connect(buttons_, &QDialogButtonBox::rejected,
@@ -290,14 +477,5 @@ KeyboardType EditKeyMapDialog::getKeyboardType() const {
 }
 
 QList<KeyMapEntry> EditKeyMapDialog::getKeyMap() const {
-  QList<KeyMapEntry> key_map;
-  for (int row = 0; row < key_map_table_->rowCount(); ++ row) {
-    KeyMapEntry entry;
-    auto actual_key_select = qobject_cast<QComboBox*>(key_map_table_->cellWidget(row, 1));
-    entry.actual_key = actual_key_select->currentData().toUInt();
-    auto map_to_key_select = qobject_cast<QComboBox*>(key_map_table_->cellWidget(row, 2));
-    entry.map_to_key = map_to_key_select->currentData().toUInt();
-    key_map.append(entry);
-  }
-  return key_map;
+  return key_map_model_->getKeyMap();
 }
@@ -1,16 +1,35 @@
 #pragma once
 
+#include <climits>
+#include <memory>
+
 #include <QDialog>
+#include <QFutureWatcher>
 
+#include <QLabel>
 #include <QLineEdit>
-#include <QTableWidget>
+#include <QTableView>
 #include <QTextEdit>
+#include <QToolButton>
+#include <QUndoStack>
+#include <QVector>
 #include <QDialogButtonBox>
 #include <QComboBox>
 #include <QPushButton>
 
 #include "winutil.hpp"
 #include "keyboarddefs.hpp"
+#include "keymapanalyzer.hpp"
+#include "keynameindex.hpp"
+#include "keymaptablemodel.hpp"
+#include "keystrokesimulator.hpp"
+#include "persistentkeymap.hpp"
+
+// State of the edited key map which undo restores. Copying it is O(1).
+struct KeyMapEditState {
+  KeyboardType keyboard_type;
+  PersistentKeyMap key_map;
+};
 
 class EditKeyMapDialog : public QDialog {
   Q_OBJECT
@@ -20,6 +39,7 @@ class EditKeyMapDialog : public QDialog {
                    const QString& current_name=QString(),
                    KeyboardType current_keyboard_type = KeyboardType::kUS,
                    const QList<KeyMapEntry>& key_map=QList<KeyMapEntry>());
+  ~EditKeyMapDialog();
   QString getName() const;
   KeyboardType getKeyboardType() const;
   QList<KeyMapEntry> getKeyMap() const;
@@ -28,25 +48,59 @@ class EditKeyMapDialog : public QDialog {
   void addMapEntry_();
   void deleteChecked_();
   void loadCurrentScancodeMap_();
+  void simulateKeyStrokes_();
+  void finishSimulation_();
   void updateKeyboardType_();
   void updateWindowState_();
+  void updateEntries_(const QModelIndex& top_left, const QModelIndex& bottom_right,
+                      const QVector<int>& roles);
+  void updateEntriesFrom_(const QModelIndex& parent, int first_row);
+  void updateButtonState_();
 
  private:
   void createWidgets_();
   void initWidgetValues_();
-  QList<KeyMapEntry> setKeyMapTable_(KeyboardType keyboard_type, const QList<KeyMapEntry>& key_map);
+  void setKeyMapTable_(KeyboardType keyboard_type, const PersistentKeyMap& key_map);
+  KeyMapEditState getEditState_() const;
+  void pushEditState_(const QString& text);
+  void restoreEditState_(const KeyMapEditState& state);
   void createConnections_();
+  void updateDifferingRows_(int first_row, int last_row);
+  void updateScanCodeLines_(int first_line, int last_line);
+  void updateAnalysis_();
 
   QStringList existing_names_;
   QString current_name_;
   KeyboardType current_keyboard_type_;
   QList<KeyMapEntry> current_key_map_;
+  // Rows which differ from current_key_map_
+  QVector<bool> differing_rows_;
+  int differing_row_count_ = 0;
+  KeyMapAnalysis analysis_;
+  QUndoStack* undo_stack_;
+  // State after the last command of undo_stack_
+  KeyMapEditState last_state_;
+  // True while the table is changed by undo or as part of another edit
+  bool undo_suspended_ = false;
+  // While true, updateEntriesFrom_ only records the lowest moved row, so
+  // that several removals are followed by a single update
+  bool entry_updates_suspended_ = false;
+  int first_moved_row_ = INT_MAX;
   QLineEdit* name_input_;
   QComboBox* keyboard_type_select_;
   QPushButton* add_entry_button_;
   QPushButton* delete_checked_button_;
   QPushButton* load_current_scan_code_map_button_;
-  QTableWidget* key_map_table_;
+  QPushButton* simulate_button_;
+  // Stream of the running simulation, which reads it on worker threads
+  std::unique_ptr<KeyStrokeStream> simulation_stream_;
+  QFutureWatcher<KeyStrokeStats> simulation_watcher_;
+  QToolButton* undo_button_;
+  QToolButton* redo_button_;
+  KeyNameIndex key_name_index_;
+  KeyMapTableModel* key_map_model_;
+  QTableView* key_map_table_;
+  QLabel* analysis_label_;
   QTextEdit* scan_code_display_;
   QDialogButtonBox* buttons_;
 };
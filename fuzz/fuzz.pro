@@ -0,0 +1,15 @@
+# libFuzzer target of the Scancode Map codec. Needs clang:
+#   qmake -spec linux-clang fuzz.pro && make && ./fuzz_scancodemap
+TEMPLATE = app
+TARGET = fuzz_scancodemap
+INCLUDEPATH += . ..
+QT -= gui
+CONFIG += c++17 console
+CONFIG -= app_bundle
+QMAKE_CXXFLAGS += -fsanitize=fuzzer,address,undefined
+QMAKE_LFLAGS += -fsanitize=fuzzer,address,undefined
+HEADERS += \
+        ../scancodemap.hpp
+SOURCES += \
+        fuzz_scancodemap.cpp \
+        ../scancodemap.cpp
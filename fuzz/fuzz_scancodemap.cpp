@@ -0,0 +1,41 @@
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#include <QByteArray>
+#include <QList>
+
+#include "scancodemap.hpp"
+
+// Decodes arbitrary bytes as a Scancode Map value and as packed entries.
+// Whatever decodes has to encode back to the same bytes.
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  if (size > INT_MAX) {
+    return 0;
+  }
+  auto bytes = reinterpret_cast<const char*>(data);
+  auto byte_count = static_cast<int>(size);
+  // Decoding reads straight from the input, so it isn't copied first
+  QList<KeyMapEntry> key_map;
+  if (decodeScancodeMap(bytes, byte_count, &key_map).isEmpty()) {
+    if (encodeScancodeMap(key_map) != QByteArray(bytes, byte_count)) {
+      std::abort();
+    }
+  }
+  QList<KeyMapEntry> entries;
+  if (decodeKeyMapEntries(bytes, byte_count, &entries).isEmpty()) {
+    auto key_code = encodeKeyMapEntries(entries);
+    if (key_code != QByteArray(bytes, byte_count)) {
+      std::abort();
+    }
+    QByteArray scancode_map;
+    appendScancodeMap(key_code, &scancode_map);
+    if (scancode_map != encodeScancodeMap(entries)) {
+      std::abort();
+    }
+  }
+  QByteArray hex_str;
+  appendHexString(bytes, byte_count, &hex_str);
+  return 0;
+}
@@ -1,134 +1,238 @@
 #include "keyboarddefs.hpp"
 
+#include <array>
+#include <iterator>
+
+#include <QHash>
+#include <QStringView>
+
+#include "layoutpack.hpp"
+
 namespace {
 
 struct KeyCode {
-  QString us_key_name;
-  QString jp_key_name;
+  const char16_t* us_key_name;
+  const char16_t* jp_key_name;
   uint16_t scan_code;
 };
 
-const QList<KeyCode> kKeyCodes = {
-  {"ESC",                "ESC",                0x0001},
-	{"TAB",								 "TAB",								 0x000F},
-	{"CapsLock",					 "CapsLock",					 0x003A},
-	{"Left Shift",				 "Left Shift",				 0x002A},
-	{"Right Shift",				 "Right Shift",				 0x0036},
-	{"Left Alt",					 "Left Alt",					 0x0038},
-	{"Right Alt",					 "Right Alt",					 0xE038},
-	{"Left Ctrl",					 "Left Ctrl",					 0x001D},
-	{"Right Ctrl",				 "Right Ctrl",				 0xE01D},
-	{"PrintScreen",				 "PrintScreen",				 0xE0A2},
-	{"Up",								 "Up",								 0xE048},
-	{"Down",							 "Down",							 0xE050},
-	{"Right",							 "Right",							 0xE04D},
-	{"Left",							 "Left",							 0xE04B},
-	{"Insert",						 "Insert",						 0xE052},
-	{"Delete",						 "Delete",						 0xE053},
-	{"Home",							 "Home",							 0xE047},
-	{"End",								 "End",								 0xE04F},
-	{"PageUp",						 "PageUp",						 0xE049},
-	{"PageDown",					 "PageDown",					 0xE051},
-	{"Left Windows key",	 "Left Windows key",	 0xE05B},
-	{"Right Windows key",	 "Right Windows key",	 0xE05C},
-	{"App",								 "App",								 0xE05D},
-	{"PAUSE",							 "PAUSE",							 0x0045},
-	{"ScrollLock",         "ScrollLock",         0x0046},
-  {"~ `",                "半角/全角",          0x0029},
-  {"! 1",                "! 1",                0x0002},
-  {"@ 2",                "\" 2",               0x0003},
-  {"# 3",                "# 3",                0x0004},
-  {"$ 4",                "$ 4",                0x0005},
-  {"% 5",                "% 5",                0x0006},
-  {"^ 6",                "& 6",                0x0007},
-  {"& 7",                "' 7",                0x0008},
-  {"* 8",                "( 8",                0x0009},
-  {"( 9",                ") 9",                0x000A},
-  {") 0",                "0",                  0x000B},
-	{"_ -",                "= -",                0x000C},
-  {"+ =",                "~ ^",                0x000D},
-  {"Backspace",          "Backspace",          0x000E},
-  {"Tab",                "Tab",                0x000F},
-  {"Q",                  "Q",                  0x0010},
-  {"W",                  "W",                  0x0011},
-  {"E",                  "E",                  0x0012},
-  {"R",                  "R",                  0x0013},
-  {"T",                  "T",                  0x0014},
-  {"Y",                  "Y",                  0x0015},
-  {"U",                  "U",                  0x0016},
-  {"I",                  "I",                  0x0017},
-  {"O",                  "O",                  0x0018},
-  {"P",                  "P",                  0x0019},
-  {"{ [",                "` @",                0x001A},
-  {"} ]",                "{ [",                0x001B},
-  {"",                   "| \\",               0x007D},
-  {"A",                  "A",                  0x001E},
-  {"S",                  "S",                  0x001F},
-  {"D",                  "D",                  0x0020},
-  {"F",                  "F",                  0x0021},
-  {"G",                  "G",                  0x0022},
-  {"H",                  "H",                  0x0023},
-  {"J",                  "J",                  0x0024},
-  {"K",                  "K",                  0x0025},
-  {"L",                  "L",                  0x0026},
-  {": ;",                "+ ;",                0x0027},
-  {"\" '",               "* :",                0x0028},
-  {"| \\",               "} ]",                0x002B},
-  {"Enter",              "Enter",              0x001C},
-  {"Z",                  "Z",                  0x002C},
-  {"X",                  "X",                  0x002D},
-  {"C",                  "C",                  0x002E},
-  {"V",                  "V",                  0x002F},
-  {"B",                  "B",                  0x0030},
-  {"N",                  "N",                  0x0031},
-  {"M",                  "M",                  0x0032},
-  {"< ,",                "< ,",                0x0033},
-  {"> .",                "> .",                0x0034},
-  {"? /",                "? /",                0x0035},
-  {"",                   "\\ _",               0x0073},
-  {"Space Bar",          "Space Bar",          0x0039},
-  {"Num Lock",           "Num Lock",           0x0045},
-  {"Numeric 7",          "Numeric 7",          0x0047},
-  {"Numeric 4",          "Numeric 4",          0x004B},
-  {"Numeric 1",          "Numeric 1",          0x004F},
-  {"Numeric /",          "Numeric /",          0xE035},
-  {"Numeric 8",          "Numeric 8",          0x0048},
-	{"Numeric 5",          "Numeric 5",          0x004C},
-	{"Numeric 2",          "Numeric 2",          0x0050},
-	{"Numeric 0",          "Numeric 0",          0x0052},
-	{"Numeric *",          "Numeric *",          0x0037},
-	{"Numeric 9",          "Numeric 9",          0x0049},
-	{"Numeric 6",          "Numeric 6",          0x004D},
-	{"Numeric 3",          "Numeric 3",          0x0051},
-	{"Numeric .",          "Numeric .",          0x0053},
-	{"Numeric -",          "Numeric -",          0x004A},
-	{"Numeric +",          "Numeric +",          0x004E},
-  {"Numeric Enter",      "Numeric Enter",      0xE01C},
-  {"F1",                 "F1",                 0x003B},
-	{"F2",                 "F2",                 0x003C},
-	{"F3",                 "F3",                 0x003D},
-	{"F4",                 "F4",                 0x003E},
-	{"F5",                 "F5",                 0x003F},
-	{"F6",                 "F6",                 0x0040},
-	{"F7",                 "F7",                 0x0041},
-	{"F8",                 "F8",                 0x0042},
-	{"F9",                 "F9",                 0x0043},
-	{"F10",                "F10",                0x0044},
-	{"F11",                "F11",                0x0057},
-	{"F12",                "F12",                0x0058},
+// Layout data lives in read-only storage. QStrings are created only when
+// a caller asks for key names.
+constexpr KeyCode kKeyCodes[] = {
+  {u"ESC",               u"ESC",               0x0001},
+  {u"TAB",               u"TAB",               0x000F},
+  {u"CapsLock",          u"CapsLock",          0x003A},
+  {u"Left Shift",        u"Left Shift",        0x002A},
+  {u"Right Shift",       u"Right Shift",       0x0036},
+  {u"Left Alt",          u"Left Alt",          0x0038},
+  {u"Right Alt",         u"Right Alt",         0xE038},
+  {u"Left Ctrl",         u"Left Ctrl",         0x001D},
+  {u"Right Ctrl",        u"Right Ctrl",        0xE01D},
+  {u"PrintScreen",       u"PrintScreen",       0xE0A2},
+  {u"Up",                u"Up",                0xE048},
+  {u"Down",              u"Down",              0xE050},
+  {u"Right",             u"Right",             0xE04D},
+  {u"Left",              u"Left",              0xE04B},
+  {u"Insert",            u"Insert",            0xE052},
+  {u"Delete",            u"Delete",            0xE053},
+  {u"Home",              u"Home",              0xE047},
+  {u"End",               u"End",               0xE04F},
+  {u"PageUp",            u"PageUp",            0xE049},
+  {u"PageDown",          u"PageDown",          0xE051},
+  {u"Left Windows key",  u"Left Windows key",  0xE05B},
+  {u"Right Windows key", u"Right Windows key", 0xE05C},
+  {u"App",               u"App",               0xE05D},
+  {u"PAUSE",             u"PAUSE",             0x0045},
+  {u"ScrollLock",        u"ScrollLock",        0x0046},
+  {u"~ `",               u"半角/全角",          0x0029},
+  {u"! 1",               u"! 1",               0x0002},
+  {u"@ 2",               u"\" 2",              0x0003},
+  {u"# 3",               u"# 3",               0x0004},
+  {u"$ 4",               u"$ 4",               0x0005},
+  {u"% 5",               u"% 5",               0x0006},
+  {u"^ 6",               u"& 6",               0x0007},
+  {u"& 7",               u"' 7",               0x0008},
+  {u"* 8",               u"( 8",               0x0009},
+  {u"( 9",               u") 9",               0x000A},
+  {u") 0",               u"0",                 0x000B},
+  {u"_ -",               u"= -",               0x000C},
+  {u"+ =",               u"~ ^",               0x000D},
+  {u"Backspace",         u"Backspace",         0x000E},
+  {u"Tab",               u"Tab",               0x000F},
+  {u"Q",                 u"Q",                 0x0010},
+  {u"W",                 u"W",                 0x0011},
+  {u"E",                 u"E",                 0x0012},
+  {u"R",                 u"R",                 0x0013},
+  {u"T",                 u"T",                 0x0014},
+  {u"Y",                 u"Y",                 0x0015},
+  {u"U",                 u"U",                 0x0016},
+  {u"I",                 u"I",                 0x0017},
+  {u"O",                 u"O",                 0x0018},
+  {u"P",                 u"P",                 0x0019},
+  {u"{ [",               u"` @",               0x001A},
+  {u"} ]",               u"{ [",               0x001B},
+  {u"",                  u"| \\",              0x007D},
+  {u"A",                 u"A",                 0x001E},
+  {u"S",                 u"S",                 0x001F},
+  {u"D",                 u"D",                 0x0020},
+  {u"F",                 u"F",                 0x0021},
+  {u"G",                 u"G",                 0x0022},
+  {u"H",                 u"H",                 0x0023},
+  {u"J",                 u"J",                 0x0024},
+  {u"K",                 u"K",                 0x0025},
+  {u"L",                 u"L",                 0x0026},
+  {u": ;",               u"+ ;",               0x0027},
+  {u"\" '",              u"* :",               0x0028},
+  {u"| \\",              u"} ]",               0x002B},
+  {u"Enter",             u"Enter",             0x001C},
+  {u"Z",                 u"Z",                 0x002C},
+  {u"X",                 u"X",                 0x002D},
+  {u"C",                 u"C",                 0x002E},
+  {u"V",                 u"V",                 0x002F},
+  {u"B",                 u"B",                 0x0030},
+  {u"N",                 u"N",                 0x0031},
+  {u"M",                 u"M",                 0x0032},
+  {u"< ,",               u"< ,",               0x0033},
+  {u"> .",               u"> .",               0x0034},
+  {u"? /",               u"? /",               0x0035},
+  {u"",                  u"\\ _",              0x0073},
+  {u"Space Bar",         u"Space Bar",         0x0039},
+  {u"Num Lock",          u"Num Lock",          0x0045},
+  {u"Numeric 7",         u"Numeric 7",         0x0047},
+  {u"Numeric 4",         u"Numeric 4",         0x004B},
+  {u"Numeric 1",         u"Numeric 1",         0x004F},
+  {u"Numeric /",         u"Numeric /",         0xE035},
+  {u"Numeric 8",         u"Numeric 8",         0x0048},
+  {u"Numeric 5",         u"Numeric 5",         0x004C},
+  {u"Numeric 2",         u"Numeric 2",         0x0050},
+  {u"Numeric 0",         u"Numeric 0",         0x0052},
+  {u"Numeric *",         u"Numeric *",         0x0037},
+  {u"Numeric 9",         u"Numeric 9",         0x0049},
+  {u"Numeric 6",         u"Numeric 6",         0x004D},
+  {u"Numeric 3",         u"Numeric 3",         0x0051},
+  {u"Numeric .",         u"Numeric .",         0x0053},
+  {u"Numeric -",         u"Numeric -",         0x004A},
+  {u"Numeric +",         u"Numeric +",         0x004E},
+  {u"Numeric Enter",     u"Numeric Enter",     0xE01C},
+  {u"F1",                u"F1",                0x003B},
+  {u"F2",                u"F2",                0x003C},
+  {u"F3",                u"F3",                0x003D},
+  {u"F4",                u"F4",                0x003E},
+  {u"F5",                u"F5",                0x003F},
+  {u"F6",                u"F6",                0x0040},
+  {u"F7",                u"F7",                0x0041},
+  {u"F8",                u"F8",                0x0042},
+  {u"F9",                u"F9",                0x0043},
+  {u"F10",               u"F10",               0x0044},
+  {u"F11",               u"F11",               0x0057},
+  {u"F12",               u"F12",               0x0058},
 };
 
-QString getKeyNameOf(KeyboardType keyboard, KeyCode key_code) {
-  QString key_name;
-  switch (keyboard) {
-    case KeyboardType::kUS:
-      key_name = key_code.us_key_name;
-      break;
-    case KeyboardType::kJP:
-      key_name = key_code.jp_key_name;
-      break;
+template <KeyboardType keyboard>
+constexpr const char16_t* getKeyNameOf(const KeyCode& key_code);
+
+template <>
+constexpr const char16_t* getKeyNameOf<KeyboardType::kUS>(const KeyCode& key_code) {
+  return key_code.us_key_name;
+}
+
+template <>
+constexpr const char16_t* getKeyNameOf<KeyboardType::kJP>(const KeyCode& key_code) {
+  return key_code.jp_key_name;
+}
+
+// Every scan code in kKeyCodes is either a plain one (0x00XX) or an
+// E0-prefixed one (0xE0XX), so the E0 bit plus the low byte is enough
+// to address all of them in a dense table.
+constexpr int kScanCodeSlotCount = 0x200;
+
+constexpr int scanCodeSlotOf(uint16_t scan_code) {
+  switch (scan_code >> 8) {
+    case 0x00:
+      return scan_code & 0xFF;
+    case 0xE0:
+      return 0x100 | (scan_code & 0xFF);
+    default:
+      return -1;
+  }
+}
+
+using KeyNameTable = std::array<const char16_t*, kScanCodeSlotCount>;
+
+template <KeyboardType keyboard>
+constexpr KeyNameTable buildKeyNameTable() {
+  KeyNameTable table{};
+  for (auto& key_code : kKeyCodes) {
+    // The first entry wins, as the linear search used to do
+    auto slot = scanCodeSlotOf(key_code.scan_code);
+    if (slot >= 0 && table[slot] == nullptr) {
+      table[slot] = getKeyNameOf<keyboard>(key_code);
+    }
+  }
+  return table;
+}
+
+template <KeyboardType keyboard>
+constexpr KeyNameTable kKeyNameTable = buildKeyNameTable<keyboard>();
+
+using ScanCodeTable = QHash<QStringView, uint16_t>;
+
+template <KeyboardType keyboard>
+const ScanCodeTable& getScanCodeTable() {
+  // Keys refer to the string literals in kKeyCodes, nothing is copied
+  static const ScanCodeTable table = [] {
+    ScanCodeTable table;
+    table.reserve(static_cast<int>(std::size(kKeyCodes)));
+    for (auto& key_code : kKeyCodes) {
+      QStringView key_name(getKeyNameOf<keyboard>(key_code));
+      if (!key_name.isEmpty() && !table.contains(key_name)) {
+        table.insert(key_name, key_code.scan_code);
+      }
+    }
+    return table;
+  }();
+  return table;
+}
+
+template <KeyboardType keyboard>
+QStringList getKeyNames() {
+  QStringList key_names;
+  key_names.reserve(static_cast<int>(std::size(kKeyCodes)));
+  for (auto& key_code : kKeyCodes) {
+    QStringView key_name(getKeyNameOf<keyboard>(key_code));
+    if (!key_name.isEmpty()) {
+      key_names.append(key_name.toString());
+    }
   }
-  return key_name;
+  return key_names;
+}
+
+struct Layout {
+  const KeyNameTable* key_name_table;
+  const ScanCodeTable& (*scan_code_table)();
+  QStringList (*key_names)();
+};
+
+template <KeyboardType keyboard>
+constexpr Layout makeLayout() {
+  return {&kKeyNameTable<keyboard>, &getScanCodeTable<keyboard>, &getKeyNames<keyboard>};
+}
+
+// Indexed by KeyboardType
+constexpr Layout kLayouts[] = {
+  makeLayout<KeyboardType::kUS>(),
+  makeLayout<KeyboardType::kJP>(),
+};
+
+const Layout& getLayoutOf(KeyboardType keyboard) {
+  // Values between the built-in types and the layout packs have no layout
+  auto idx = static_cast<size_t>(keyboard);
+  Q_ASSERT(idx < std::size(kLayouts));
+  return idx < std::size(kLayouts) ? kLayouts[idx] : kLayouts[0];
+}
+
+bool isLayoutPack(KeyboardType keyboard) {
+  return static_cast<int>(keyboard) >= kFirstLayoutPack;
 }
 
 }  // namespace
@@ -139,11 +243,17 @@ KeyboardType getKeyboardTypeFromString(const QString& keyboard_type_str) {
     keyboard_type = KeyboardType::kUS;
   } else if (keyboard_type_str == "JP") {
     keyboard_type = KeyboardType::kJP;
+  } else if (getLayoutPackNames().contains(keyboard_type_str)) {
+    keyboard_type = static_cast<KeyboardType>(
+        kFirstLayoutPack + getLayoutPackNames().indexOf(keyboard_type_str));
   }
   return keyboard_type;
 }
 
 QString getStringOfKeyboardType(KeyboardType keyboard_type) {
+  if (isLayoutPack(keyboard_type)) {
+    return getLayoutPackNames().value(static_cast<int>(keyboard_type) - kFirstLayoutPack);
+  }
   QString keyboard_type_str = "US";
   switch (keyboard_type) {
     case KeyboardType::kUS:
@@ -156,35 +266,53 @@ QString getStringOfKeyboardType(KeyboardType keyboard_type) {
   return keyboard_type_str;
 }
 
+QStringList getKeyboardTypeNames() {
+  return QStringList{getStringOfKeyboardType(KeyboardType::kUS),
+                     getStringOfKeyboardType(KeyboardType::kJP)}
+      + getLayoutPackNames();
+}
+
 QStringList getKeyNames(KeyboardType keyboard) {
-  QStringList key_names;
-  for (auto& key_code : kKeyCodes) {
-    auto key_name = getKeyNameOf(keyboard, key_code);
-    if (!key_name.isEmpty()) {
-      key_names.append(key_name);
-    }
+  if (isLayoutPack(keyboard)) {
+    auto layout_pack = getLayoutPackOf(keyboard);
+    return layout_pack ? layout_pack->getKeyNames() : QStringList();
   }
-  return key_names;
+  return getLayoutOf(keyboard).key_names();
 }
 
 QString getKeyNameOf(KeyboardType keyboard, uint16_t scan_code) {
-  QString key_name;
-  for (auto& key_code : kKeyCodes) {
-    if (key_code.scan_code == scan_code) {
-      key_name = getKeyNameOf(keyboard, key_code);
-      break;
-    }
+  if (isLayoutPack(keyboard)) {
+    auto layout_pack = getLayoutPackOf(keyboard);
+    return layout_pack ? layout_pack->getKeyNameOf(scan_code) : QString();
+  }
+  auto slot = scanCodeSlotOf(scan_code);
+  if (slot < 0) {
+    return QString();
+  }
+  auto key_name = (*getLayoutOf(keyboard).key_name_table)[slot];
+  if (key_name == nullptr) {
+    return QString();
   }
-  return key_name;
+  return QStringView(key_name).toString();
+}
+
+bool isKeyDefined(KeyboardType keyboard, uint16_t scan_code) {
+  if (isLayoutPack(keyboard)) {
+    auto layout_pack = getLayoutPackOf(keyboard);
+    return layout_pack && !layout_pack->getKeyNameOf(scan_code).isEmpty();
+  }
+  auto slot = scanCodeSlotOf(scan_code);
+  if (slot < 0) {
+    return false;
+  }
+  auto key_name = (*getLayoutOf(keyboard).key_name_table)[slot];
+  return key_name != nullptr && key_name[0] != u'\0';
 }
 
 uint16_t getScanCodeOf(KeyboardType keyboard, const QString& key_name) {
-  uint16_t scan_code = 0;
-  for (auto& key_code : kKeyCodes) {
-    if (key_name == getKeyNameOf(keyboard, key_code)) {
-      scan_code = key_code.scan_code;
-      break;
-    }
+  if (isLayoutPack(keyboard)) {
+    auto layout_pack = getLayoutPackOf(keyboard);
+    return layout_pack ? layout_pack->getScanCodeOf(key_name) : 0;
   }
-  return scan_code;
+  return getLayoutOf(keyboard).scan_code_table().value(QStringView(key_name), 0);
 }
@@ -9,9 +9,18 @@ enum class KeyboardType {
   kJP
 };
 
+// Keyboard types from this value on are layout packs (layoutpack.hpp)
+const int kFirstLayoutPack = 0x100;
+
+// Returns the names of the built-in keyboard types and the installed
+// layout packs
+QStringList getKeyboardTypeNames();
+
 KeyboardType getKeyboardTypeFromString(const QString& keyboard_type_str);
 QString getStringOfKeyboardType(KeyboardType keyboard_type);
 
 QStringList getKeyNames(KeyboardType keyboard);
 QString getKeyNameOf(KeyboardType keyboard, uint16_t scan_code);
+// Returns true if the keyboard has a key name for the scan code
+bool isKeyDefined(KeyboardType keyboard, uint16_t scan_code);
 uint16_t getScanCodeOf(KeyboardType keyboard, const QString& key_name);
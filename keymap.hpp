@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+#include "keyboarddefs.hpp"
+#include "scancodemap.hpp"
+
+struct KeyMap {
+  QString name;
+  KeyboardType keyboard_type;
+  QList<KeyMapEntry> key_map;
+  bool operator==(const KeyMap& rhs) const {
+    return name == rhs.name
+      && keyboard_type == rhs.keyboard_type
+      && key_map == rhs.key_map;
+  }
+};
+
+// Saved key map whose entries are still packed as in keysetup.ini
+struct PackedKeyMap {
+  QString name;
+  KeyboardType keyboard_type;
+  QByteArray key_code;
+  // getKeyMapHash() of the entries
+  quint64 hash;
+  // Saved name of a keyboard type which isn't known here, such as a layout
+  // pack which isn't installed. keyboard_type is kUS then, and the name is
+  // saved back as it is.
+  QString unknown_keyboard_type;
+  QString getKeyboardTypeName() const {
+    return unknown_keyboard_type.isEmpty()
+        ? getStringOfKeyboardType(keyboard_type) : unknown_keyboard_type;
+  }
+};
@@ -0,0 +1,149 @@
+#include "keymapalgebra.hpp"
+
+#include <bitset>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+namespace {
+
+const int kScanCodeCount = 0x10000;
+
+// Key map as a direct-indexed table over the whole scan code space, so
+// that a lookup is O(1) and an operation is linear in the entry count.
+class ScanCodeLookup {
+ public:
+  explicit ScanCodeLookup(const QList<KeyMapEntry>& key_map)
+      : map_to_(kScanCodeCount) {
+    std::iota(map_to_.begin(), map_to_.end(), 0);
+    for (auto& entry : key_map) {
+      if (!remapped_.test(entry.actual_key)) {
+        remapped_.set(entry.actual_key);
+        map_to_[entry.actual_key] = entry.map_to_key;
+      }
+    }
+  }
+  uint16_t operator[](uint16_t scan_code) const {
+    return map_to_[scan_code];
+  }
+
+ private:
+  std::vector<uint16_t> map_to_;
+  std::bitset<kScanCodeCount> remapped_;
+};
+
+// Collects the actual keys of key maps once each, in the order they
+// first appear
+class ActualKeySet {
+ public:
+  void add(const QList<KeyMapEntry>& key_map) {
+    for (auto& entry : key_map) {
+      if (!added_->test(entry.actual_key)) {
+        added_->set(entry.actual_key);
+        keys_.append(entry.actual_key);
+      }
+    }
+  }
+  const QList<uint16_t>& getKeys() const {
+    return keys_;
+  }
+
+ private:
+  std::unique_ptr<std::bitset<kScanCodeCount>> added_ =
+      std::make_unique<std::bitset<kScanCodeCount>>();
+  QList<uint16_t> keys_;
+};
+
+}  // namespace
+
+QList<KeyMapEntry> composeKeyMaps(const QList<KeyMapEntry>& first,
+                                  const QList<KeyMapEntry>& second) {
+  ScanCodeLookup first_lookup(first);
+  ScanCodeLookup second_lookup(second);
+  ActualKeySet actual_keys;
+  actual_keys.add(first);
+  actual_keys.add(second);
+  QList<KeyMapEntry> composed;
+  for (auto actual_key : actual_keys.getKeys()) {
+    auto map_to_key = first_lookup[actual_key];
+    // A disabled key stays disabled
+    if (map_to_key != kDisabledKey) {
+      map_to_key = second_lookup[map_to_key];
+    }
+    if (map_to_key != actual_key) {
+      composed.append({actual_key, map_to_key});
+    }
+  }
+  return composed;
+}
+
+QString invertKeyMap(const QList<KeyMapEntry>& key_map, QList<KeyMapEntry>* inverted) {
+  ScanCodeLookup lookup(key_map);
+  ActualKeySet actual_keys;
+  actual_keys.add(key_map);
+  auto mapped = std::make_unique<std::bitset<kScanCodeCount>>();
+  QList<KeyMapEntry> result;
+  for (auto actual_key : actual_keys.getKeys()) {
+    auto map_to_key = lookup[actual_key];
+    if (map_to_key == actual_key) {
+      continue;
+    }
+    if (map_to_key == kDisabledKey) {
+      return QString("Disabled key 0x%1 can't be inverted").arg(actual_key, 4, 16, QChar('0'));
+    }
+    // A key which isn't remapped away still produces itself
+    if (mapped->test(map_to_key) || lookup[map_to_key] == map_to_key) {
+      return QString("More than one key is mapped to 0x%1").arg(map_to_key, 4, 16, QChar('0'));
+    }
+    mapped->set(map_to_key);
+    result.append({map_to_key, actual_key});
+  }
+  *inverted = result;
+  return QString();
+}
+
+QList<KeyMapDifference> diffKeyMaps(const QList<KeyMapEntry>& lhs,
+                                    const QList<KeyMapEntry>& rhs) {
+  ScanCodeLookup lhs_lookup(lhs);
+  ScanCodeLookup rhs_lookup(rhs);
+  ActualKeySet actual_keys;
+  actual_keys.add(lhs);
+  actual_keys.add(rhs);
+  QList<KeyMapDifference> differences;
+  for (auto actual_key : actual_keys.getKeys()) {
+    if (lhs_lookup[actual_key] != rhs_lookup[actual_key]) {
+      differences.append({actual_key, lhs_lookup[actual_key], rhs_lookup[actual_key]});
+    }
+  }
+  return differences;
+}
+
+QList<KeyMapEntry> mergeKeyMaps(const QList<KeyMapEntry>& base,
+                                const QList<KeyMapEntry>& ours,
+                                const QList<KeyMapEntry>& theirs,
+                                QList<KeyMapConflict>* conflicts) {
+  ScanCodeLookup base_lookup(base);
+  ScanCodeLookup ours_lookup(ours);
+  ScanCodeLookup theirs_lookup(theirs);
+  ActualKeySet actual_keys;
+  actual_keys.add(base);
+  actual_keys.add(ours);
+  actual_keys.add(theirs);
+  QList<KeyMapEntry> merged;
+  for (auto actual_key : actual_keys.getKeys()) {
+    auto base_map_to_key = base_lookup[actual_key];
+    auto ours_map_to_key = ours_lookup[actual_key];
+    auto theirs_map_to_key = theirs_lookup[actual_key];
+    auto map_to_key = ours_map_to_key;
+    if (ours_map_to_key == base_map_to_key) {
+      map_to_key = theirs_map_to_key;
+    } else if (theirs_map_to_key != base_map_to_key && theirs_map_to_key != ours_map_to_key
+               && conflicts) {
+      conflicts->append({actual_key, base_map_to_key, ours_map_to_key, theirs_map_to_key});
+    }
+    if (map_to_key != actual_key) {
+      merged.append({actual_key, map_to_key});
+    }
+  }
+  return merged;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <QList>
+#include <QString>
+
+#include "scancodemap.hpp"
+
+// A key map is treated as a function over scan codes, which maps keys
+// without an entry to themselves. A map to key of 0 disables the key.
+// When an actual key has more than one entry, the first one is used.
+// Results have no identity entries, and keep the order in which keys
+// first appear in the operands.
+
+// Scan code of a disabled key
+const uint16_t kDisabledKey = 0x0000;
+
+// Key whose mapping differs between two key maps
+struct KeyMapDifference {
+  uint16_t actual_key;
+  uint16_t lhs_map_to_key;
+  uint16_t rhs_map_to_key;
+};
+
+// Key which both sides of a merge have changed differently
+struct KeyMapConflict {
+  uint16_t actual_key;
+  uint16_t base_map_to_key;
+  uint16_t ours_map_to_key;
+  uint16_t theirs_map_to_key;
+};
+
+// Returns the key map which applies first and then second, e.g. a base
+// layout and then an overlay
+QList<KeyMapEntry> composeKeyMaps(const QList<KeyMapEntry>& first,
+                                  const QList<KeyMapEntry>& second);
+
+// Inverts key_map. Returns error message when two keys produce the same
+// key, or a key is disabled, as it can't be inverted then. A key which
+// isn't remapped produces itself, so mapping another key to it fails too.
+QString invertKeyMap(const QList<KeyMapEntry>& key_map, QList<KeyMapEntry>* inverted);
+
+// Returns the keys which lhs and rhs map differently
+QList<KeyMapDifference> diffKeyMaps(const QList<KeyMapEntry>& lhs,
+                                    const QList<KeyMapEntry>& rhs);
+
+// Merges the changes of ours and theirs from base. A key which both have
+// changed differently takes the mapping of ours, and is reported in
+// conflicts.
+QList<KeyMapEntry> mergeKeyMaps(const QList<KeyMapEntry>& base,
+                                const QList<KeyMapEntry>& ours,
+                                const QList<KeyMapEntry>& theirs,
+                                QList<KeyMapConflict>* conflicts = nullptr);
@@ -0,0 +1,119 @@
+#include "keymapanalyzer.hpp"
+
+#include <bitset>
+#include <vector>
+
+#include <QStringList>
+
+namespace {
+
+const int kScanCodeCount = 0x10000;
+
+// Direct-indexed tables over the whole scan code space. They are reused
+// between calls and only the touched slots are reset, so an analysis
+// costs O(n) whatever the size of the tables.
+struct ScanCodeTables {
+  std::bitset<kScanCodeCount> remapped;
+  std::vector<int> entry_of_actual_key = std::vector<int>(kScanCodeCount, -1);
+};
+
+ScanCodeTables& getScanCodeTables() {
+  static thread_local ScanCodeTables tables;
+  return tables;
+}
+
+enum VisitState {
+  kUnvisited,
+  kOnPath,
+  kVisited
+};
+
+}  // namespace
+
+KeyMapAnalysis analyzeKeyMap(KeyboardType keyboard_type, const QList<KeyMapEntry>& key_map) {
+  KeyMapAnalysis analysis;
+  auto entry_count = key_map.count();
+  analysis.entry_issues.fill(kNoIssue, entry_count);
+  auto& issues = analysis.entry_issues;
+  auto& tables = getScanCodeTables();
+
+  // Actual keys, duplicates, identities and undefined keys
+  for (int idx = 0; idx < entry_count; ++ idx) {
+    auto& entry = key_map[idx];
+    if (tables.remapped.test(entry.actual_key)) {
+      issues[idx] |= kDuplicateActualKey;
+      issues[tables.entry_of_actual_key[entry.actual_key]] |= kDuplicateActualKey;
+    } else {
+      tables.remapped.set(entry.actual_key);
+      tables.entry_of_actual_key[entry.actual_key] = idx;
+    }
+    if (entry.actual_key == entry.map_to_key) {
+      issues[idx] |= kIdentityMapping;
+    }
+    if (!isKeyDefined(keyboard_type, entry.actual_key)
+        || !isKeyDefined(keyboard_type, entry.map_to_key)) {
+      issues[idx] |= kUndefinedKey;
+    }
+  }
+
+  // Chains and cycles. Each entry points to the entry remapping its map
+  // to key, so every entry is walked once.
+  QVector<int> next_entry(entry_count, -1);
+  for (int idx = 0; idx < entry_count; ++ idx) {
+    auto& entry = key_map[idx];
+    if (entry.actual_key != entry.map_to_key && tables.remapped.test(entry.map_to_key)) {
+      next_entry[idx] = tables.entry_of_actual_key[entry.map_to_key];
+      issues[idx] |= kChainedMapping;
+    }
+  }
+  QVector<int> visit_states(entry_count, kUnvisited);
+  QVector<int> path;
+  for (int start = 0; start < entry_count; ++ start) {
+    path.clear();
+    int idx = start;
+    while (idx >= 0 && visit_states[idx] == kUnvisited) {
+      visit_states[idx] = kOnPath;
+      path.append(idx);
+      idx = next_entry[idx];
+    }
+    if (idx >= 0 && visit_states[idx] == kOnPath) {
+      for (int path_idx = path.indexOf(idx); path_idx < path.count(); ++ path_idx) {
+        issues[path[path_idx]] |= kCyclicMapping;
+      }
+    }
+    for (auto path_entry : path) {
+      visit_states[path_entry] = kVisited;
+    }
+  }
+
+  for (int idx = 0; idx < entry_count; ++ idx) {
+    // Reset only what this call has set
+    tables.remapped.reset(key_map[idx].actual_key);
+    tables.entry_of_actual_key[key_map[idx].actual_key] = -1;
+    if (issues[idx] & kKeyMapErrors) {
+      ++ analysis.error_count;
+    } else if (issues[idx] != kNoIssue) {
+      ++ analysis.warning_count;
+    }
+  }
+  return analysis;
+}
+
+QString describeKeyMapIssues(int issues) {
+  QStringList descriptions;
+  if (issues & kDuplicateActualKey) {
+    descriptions.append("The actual key is mapped more than once");
+  }
+  if (issues & kIdentityMapping) {
+    descriptions.append("The key is mapped to itself");
+  }
+  if (issues & kCyclicMapping) {
+    descriptions.append("The mapping is part of a cycle");
+  } else if (issues & kChainedMapping) {
+    descriptions.append("The key is mapped to a key which is remapped too");
+  }
+  if (issues & kUndefinedKey) {
+    descriptions.append("The keyboard type doesn't define the key");
+  }
+  return descriptions.join("\n");
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QList>
+#include <QString>
+#include <QVector>
+
+#include "keyboarddefs.hpp"
+#include "scancodemap.hpp"
+
+// Problems of a key map entry, combined as bit flags
+enum KeyMapIssue {
+  kNoIssue = 0,
+  // Another entry remaps the same actual key. Windows uses only one of
+  // them, so this is an error.
+  kDuplicateActualKey = 1 << 0,
+  // The key is mapped to itself
+  kIdentityMapping = 1 << 1,
+  // The key is mapped to a key which is remapped too. Windows doesn't
+  // follow chains, so the result may not be what was meant.
+  kChainedMapping = 1 << 2,
+  // The entry is part of a cycle, e.g. A -> B and B -> A (a swap)
+  kCyclicMapping = 1 << 3,
+  // The keyboard type has no name for a scan code of the entry
+  kUndefinedKey = 1 << 4,
+};
+
+const int kKeyMapErrors = kDuplicateActualKey;
+
+struct KeyMapAnalysis {
+  // Issues of each entry
+  QVector<int> entry_issues;
+  int error_count = 0;
+  int warning_count = 0;
+};
+
+// Finds the issues of all entries in one pass
+KeyMapAnalysis analyzeKeyMap(KeyboardType keyboard_type, const QList<KeyMapEntry>& key_map);
+
+// Returns a readable description of issues, one per line
+QString describeKeyMapIssues(int issues);
@@ -0,0 +1,170 @@
+#include "keymapexport.hpp"
+
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtEndian>
+
+#include "scancodemap.hpp"
+#include "trace.hpp"
+
+namespace {
+
+const int kBufferSize = 1 << 16;
+// regedit wraps binary values to fit this width
+const int kRegLineWidth = 80;
+
+void appendRegBinary(const QByteArray& data, int column, QByteArray* out) {
+  for (int idx = 0; idx < data.size(); ++ idx) {
+    out->append(getHexDigitsOf(static_cast<uchar>(data[idx])), 2);
+    column += 2;
+    if (idx + 1 == data.size()) {
+      break;
+    }
+    out->append(',');
+    ++ column;
+    // The next byte, its comma and the backslash have to fit
+    if (column + 4 > kRegLineWidth) {
+      out->append("\\\r\n  ");
+      column = 2;
+    }
+  }
+  out->append("\r\n");
+}
+
+void appendJsonString(const QString& str, QByteArray* out) {
+  out->append('"');
+  for (auto ch : str.toUtf8()) {
+    auto byte = static_cast<uchar>(ch);
+    if (ch == '"' || ch == '\\') {
+      out->append('\\');
+      out->append(ch);
+    } else if (byte < 0x20) {
+      out->append("\\u00");
+      out->append(getHexDigitsOf(byte), 2);
+    } else {
+      out->append(ch);
+    }
+  }
+  out->append('"');
+}
+
+void appendKeyMap(const PackedKeyMap& key_map, ExportFormat format, bool first,
+                  QByteArray* scancode_map, QByteArray* out) {
+  scancode_map->resize(0);
+  appendScancodeMap(key_map.key_code, scancode_map);
+  switch (format) {
+    case ExportFormat::kHex:
+      out->append('[');
+      out->append(key_map.name.toUtf8());
+      out->append("]\n");
+      appendHexString(scancode_map->constData(), scancode_map->size(), out);
+      out->append('\n');
+      break;
+    case ExportFormat::kReg: {
+      // Key names can't have backslashes
+      auto name = key_map.name;
+      name.replace('\\', '_');
+      out->append("\r\n[");
+      out->append(kExportRegistryKey);
+      out->append(name.toUtf8());
+      out->append("]\r\n\"kb_type\"=\"");
+      out->append(key_map.getKeyboardTypeName().toUtf8());
+      out->append("\"\r\n");
+      const char value_name[] = "\"Scancode Map\"=hex:";
+      out->append(value_name);
+      appendRegBinary(*scancode_map, sizeof(value_name) - 1, out);
+      break;
+    }
+    case ExportFormat::kJson:
+      out->append(first ? "\n  {\"name\": " : ",\n  {\"name\": ");
+      appendJsonString(key_map.name, out);
+      out->append(", \"keyboard_type\": ");
+      appendJsonString(key_map.getKeyboardTypeName(), out);
+      out->append(", \"scancode_map\": \"");
+      for (auto byte : *scancode_map) {
+        out->append(getHexDigitsOf(static_cast<uchar>(byte)), 2);
+      }
+      out->append("\"}");
+      break;
+  }
+}
+
+// Returns error message
+QString writeBuffer(QIODevice* device, ExportFormat format, QByteArray* buffer) {
+  // The buffer holds UTF-8. regedit reads version 5 files as UTF-16LE,
+  // so those are converted a buffer at a time.
+  QByteArray utf16_buffer;
+  auto data = buffer;
+  if (format == ExportFormat::kReg) {
+    auto text = QString::fromUtf8(*buffer);
+    utf16_buffer.resize(text.size() * 2);
+    qToLittleEndian<quint16>(text.utf16(), text.size(), utf16_buffer.data());
+    data = &utf16_buffer;
+  }
+  if (device->write(*data) != data->size()) {
+    return device->errorString();
+  }
+  // Keeps the capacity, which has been reserved
+  buffer->resize(0);
+  return "";
+}
+
+}  // namespace
+
+ExportFormat getExportFormatOf(const QString& file_path) {
+  auto suffix = QFileInfo(file_path).suffix().toLower();
+  if (suffix == "reg") {
+    return ExportFormat::kReg;
+  } else if (suffix == "json") {
+    return ExportFormat::kJson;
+  }
+  return ExportFormat::kHex;
+}
+
+QString exportKeyMaps(const QList<PackedKeyMap>& key_maps, ExportFormat format,
+                      QIODevice* device) {
+  TraceSpan span("exportKeyMaps");
+  QByteArray buffer;
+  buffer.reserve(kBufferSize * 2);
+  QByteArray scancode_map;
+  scancode_map.reserve(kBufferSize);
+  if (format == ExportFormat::kReg) {
+    // Byte order mark
+    if (device->write("\xff\xfe", 2) != 2) {
+      return device->errorString();
+    }
+    buffer.append("Windows Registry Editor Version 5.00\r\n");
+  } else if (format == ExportFormat::kJson) {
+    buffer.append('[');
+  }
+  for (int idx = 0; idx < key_maps.count(); ++ idx) {
+    appendKeyMap(key_maps[idx], format, idx == 0, &scancode_map, &buffer);
+    if (buffer.size() >= kBufferSize) {
+      auto err_msg = writeBuffer(device, format, &buffer);
+      if (!err_msg.isEmpty()) {
+        return err_msg;
+      }
+    }
+  }
+  if (format == ExportFormat::kJson) {
+    buffer.append(key_maps.isEmpty() ? "]\n" : "\n]\n");
+  }
+  return writeBuffer(device, format, &buffer);
+}
+
+QString exportKeyMaps(const QList<PackedKeyMap>& key_maps, ExportFormat format,
+                      const QString& file_path) {
+  QSaveFile file(file_path);
+  if (!file.open(QIODevice::WriteOnly)) {
+    return file.errorString();
+  }
+  auto err_msg = exportKeyMaps(key_maps, format, &file);
+  if (!err_msg.isEmpty()) {
+    file.cancelWriting();
+    return err_msg;
+  }
+  if (!file.commit()) {
+    return file.errorString();
+  }
+  return "";
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <QIODevice>
+#include <QList>
+#include <QString>
+
+#include "keymap.hpp"
+
+// Registry key under which a .reg export writes each key map, as
+// <key>\<name> with "kb_type" and "Scancode Map" values. Importing the
+// file into the registry doesn't change the applied key map.
+const char kExportRegistryKey[] = R"(HKEY_CURRENT_USER\Software\SetKeyMap\Key maps\)";
+
+enum class ExportFormat {
+  // "[name]" lines followed by the Scancode Map in encodeToHexString() format
+  kHex,
+  kReg,
+  // Array of objects with name, keyboard_type and scancode_map as a hex string
+  kJson
+};
+
+// Returns the format for the suffix of file_path, kHex unless it is .reg
+// or .json
+ExportFormat getExportFormatOf(const QString& file_path);
+
+// Writes the key maps to device. Key maps are formatted from their packed
+// entries into a reused buffer, which is written whenever it fills up.
+// Returns error message
+QString exportKeyMaps(const QList<PackedKeyMap>& key_maps, ExportFormat format,
+                      QIODevice* device);
+// Writes file_path atomically. Returns error message
+QString exportKeyMaps(const QList<PackedKeyMap>& key_maps, ExportFormat format,
+                      const QString& file_path);
@@ -0,0 +1,45 @@
+#include "keymaphash.hpp"
+
+#include <algorithm>
+
+namespace {
+
+const quint64 kHashSeed = 0x9E3779B97F4A7C15ULL;
+
+// Finalizer of MurmurHash3
+quint64 mix(quint64 value) {
+  value ^= value >> 33;
+  value *= 0xFF51AFD7ED558CCDULL;
+  value ^= value >> 33;
+  value *= 0xC4CEB9FE1A85EC53ULL;
+  value ^= value >> 33;
+  return value;
+}
+
+}  // namespace
+
+QList<KeyMapEntry> getCanonicalKeyMap(const QList<KeyMapEntry>& key_map) {
+  QList<KeyMapEntry> canonical_key_map;
+  canonical_key_map.reserve(key_map.count());
+  for (auto& entry : key_map) {
+    if (entry.actual_key != entry.map_to_key) {
+      canonical_key_map.append(entry);
+    }
+  }
+  std::sort(canonical_key_map.begin(), canonical_key_map.end(),
+            [](const KeyMapEntry& lhs, const KeyMapEntry& rhs) {
+              return lhs.actual_key != rhs.actual_key
+                  ? lhs.actual_key < rhs.actual_key
+                  : lhs.map_to_key < rhs.map_to_key;
+            });
+  return canonical_key_map;
+}
+
+quint64 getKeyMapHash(const QList<KeyMapEntry>& key_map) {
+  quint64 hash = kHashSeed;
+  for (auto& entry : getCanonicalKeyMap(key_map)) {
+    quint64 value = (static_cast<quint64>(entry.actual_key) << 16) | entry.map_to_key;
+    hash = mix(hash ^ value) + kHashSeed;
+  }
+  return hash;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <QList>
+#include <QtGlobal>
+
+#include "scancodemap.hpp"
+
+// Returns key_map without identity entries and sorted by actual key.
+// Key maps which have the same effect have the same canonical form.
+QList<KeyMapEntry> getCanonicalKeyMap(const QList<KeyMapEntry>& key_map);
+
+// Returns the 64-bit hash of the canonical form of key_map
+quint64 getKeyMapHash(const QList<KeyMapEntry>& key_map);
@@ -0,0 +1,359 @@
+#include "keymapimport.hpp"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMultiHash>
+#include <QRegularExpression>
+#include <QSettings>
+#include <QTextStream>
+#include <QtConcurrent>
+
+#include "keymapexport.hpp"
+#include "keymaphash.hpp"
+#include "profilestore.hpp"
+#include "trace.hpp"
+
+namespace {
+
+const char* const kImportFilePatterns[] = {"*.reg", "*.hex", "*.txt", "*.ini"};
+const QString kScancodeMapValueName = "\"Scancode Map\"=";
+const QString kKeyboardTypeValueName = "\"kb_type\"=";
+
+int getHexDigitValue(QChar ch) {
+  auto code = ch.unicode();
+  if (code >= '0' && code <= '9') {
+    return code - '0';
+  } else if (code >= 'a' && code <= 'f') {
+    return code - 'a' + 10;
+  } else if (code >= 'A' && code <= 'F') {
+    return code - 'A' + 10;
+  }
+  return -1;
+}
+
+// Appends bytes written in hex and separated by commas or white spaces.
+// Returns false if text has anything else.
+bool appendHexBytes(const QString& text, QByteArray* bytes) {
+  int value = 0;
+  int digit_count = 0;
+  for (auto ch : text) {
+    auto digit = getHexDigitValue(ch);
+    if (digit >= 0) {
+      if (digit_count == 2) {
+        return false;
+      }
+      value = value * 16 + digit;
+      ++ digit_count;
+    } else if (ch == ',' || ch.isSpace()) {
+      if (digit_count > 0) {
+        bytes->append(static_cast<char>(value));
+        value = 0;
+        digit_count = 0;
+      }
+    } else {
+      return false;
+    }
+  }
+  if (digit_count > 0) {
+    bytes->append(static_cast<char>(value));
+  }
+  return true;
+}
+
+// Returns error message
+QString readText(const QString& file_path, QString* text) {
+  QFile file(file_path);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return file.errorString();
+  }
+  // Files are UTF-8 unless they start with a byte order mark, as
+  // regedit's UTF-16 files do
+  QTextStream in(&file);
+  in.setCodec("UTF-8");
+  *text = in.readAll();
+  return "";
+}
+
+QString decodeNamedScancodeMap(const QString& name, const QByteArray& data,
+                               QList<KeyMapEntry>* key_map) {
+  auto err_msg = decodeScancodeMap(data, key_map);
+  return err_msg.isEmpty() ? "" : QString("'%1': %2").arg(name, err_msg);
+}
+
+void parseRegFile(const QString& file_path, KeyboardType keyboard_type,
+                  ImportFileResult* result) {
+  QString text;
+  result->error = readText(file_path, &text);
+  if (!result->error.isEmpty()) {
+    return;
+  }
+  // Long values continue to the next line after a backslash
+  static const QRegularExpression continuation("\\\\\\r?\\n\\s*");
+  text.replace(continuation, "");
+  // A value of the system key is named after the file. Key maps exported
+  // by exportKeyMaps() have keys of their own, which name them.
+  auto file_name = QFileInfo(file_path).completeBaseName();
+  const QString export_key = kExportRegistryKey;
+  auto name = file_name;
+  auto section_keyboard_type = keyboard_type;
+  int section_first_idx = 0;
+  for (auto& line : text.splitRef('\n')) {
+    auto trimmed_line = line.trimmed();
+    if (trimmed_line.startsWith('[') && trimmed_line.endsWith(']')) {
+      auto key_path = trimmed_line.mid(1, trimmed_line.length() - 2);
+      name = key_path.startsWith(export_key, Qt::CaseInsensitive)
+          ? key_path.mid(export_key.length()).toString() : file_name;
+      section_keyboard_type = keyboard_type;
+      section_first_idx = result->key_maps.count();
+    } else if (trimmed_line.startsWith(kKeyboardTypeValueName, Qt::CaseInsensitive)) {
+      auto value = trimmed_line.mid(kKeyboardTypeValueName.length());
+      if (value.length() >= 2 && value.startsWith('"') && value.endsWith('"')) {
+        section_keyboard_type = getKeyboardTypeFromString(
+            value.mid(1, value.length() - 2).toString());
+      }
+      // The value may follow the Scancode Map of the key
+      for (int idx = section_first_idx; idx < result->key_maps.count(); ++ idx) {
+        result->key_maps[idx].keyboard_type = section_keyboard_type;
+      }
+    } else if (trimmed_line.startsWith(kScancodeMapValueName, Qt::CaseInsensitive)) {
+      auto value = trimmed_line.mid(kScancodeMapValueName.length());
+      if (!value.startsWith("hex:", Qt::CaseInsensitive)) {
+        result->error = "Scancode Map is not a binary value";
+        return;
+      }
+      QByteArray data;
+      if (!appendHexBytes(value.mid(4).toString(), &data)) {
+        result->error = "Scancode Map has an invalid byte";
+        return;
+      }
+      KeyMap key_map{name, section_keyboard_type, {}};
+      result->error = decodeNamedScancodeMap(name, data, &key_map.key_map);
+      if (!result->error.isEmpty()) {
+        return;
+      }
+      result->key_maps.append(key_map);
+    }
+  }
+  if (result->key_maps.isEmpty()) {
+    result->error = "No Scancode Map value";
+  }
+}
+
+void parseHexFile(const QString& file_path, KeyboardType keyboard_type,
+                  ImportFileResult* result) {
+  QString text;
+  result->error = readText(file_path, &text);
+  if (!result->error.isEmpty()) {
+    return;
+  }
+  KeyMap key_map{QFileInfo(file_path).completeBaseName(), keyboard_type, {}};
+  QByteArray data;
+  auto add_key_map = [&] {
+    if (data.isEmpty()) {
+      return true;
+    }
+    result->error = decodeNamedScancodeMap(key_map.name, data, &key_map.key_map);
+    if (!result->error.isEmpty()) {
+      return false;
+    }
+    result->key_maps.append(key_map);
+    data.clear();
+    return true;
+  };
+  int line_number = 0;
+  for (auto& line : text.splitRef('\n')) {
+    ++ line_number;
+    auto trimmed_line = line.trimmed();
+    if (trimmed_line.startsWith(';') || trimmed_line.startsWith('#')) {
+      continue;
+    }
+    if (trimmed_line.startsWith('[') && trimmed_line.endsWith(']')) {
+      if (!add_key_map()) {
+        return;
+      }
+      key_map.name = trimmed_line.mid(1, trimmed_line.length() - 2).trimmed().toString();
+      continue;
+    }
+    if (!appendHexBytes(trimmed_line.toString(), &data)) {
+      result->error = QString("Line %1 is not hex bytes").arg(line_number);
+      return;
+    }
+  }
+  if (add_key_map() && result->key_maps.isEmpty()) {
+    result->error = "No key map";
+  }
+}
+
+void parseIniFile(const QString& file_path, KeyboardType keyboard_type,
+                  ImportFileResult* result) {
+  // Same layout as keysetup.ini
+  QSettings settings(file_path, QSettings::IniFormat);
+  if (settings.status() != QSettings::NoError) {
+    result->error = "Failed to read the file";
+    return;
+  }
+  for (auto& name : settings.childGroups()) {
+    KeyMap key_map{name, keyboard_type, {}};
+    auto keyboard_type_str = settings.value(name + "/kb_type", QString()).toString();
+    if (!keyboard_type_str.isEmpty()) {
+      key_map.keyboard_type = getKeyboardTypeFromString(keyboard_type_str);
+    }
+    auto key_code = settings.value(name + "/code", QByteArray()).toByteArray();
+    auto err_msg = decodeKeyMapEntries(key_code, &key_map.key_map);
+    if (!err_msg.isEmpty()) {
+      result->error = QString("'%1': %2").arg(name, err_msg);
+      return;
+    }
+    result->key_maps.append(key_map);
+  }
+  if (result->key_maps.isEmpty()) {
+    result->error = "No key map";
+  }
+}
+
+struct ImportFileParser {
+  using result_type = ImportFileResult;
+  ImportFileResult operator()(const QString& file_path) const {
+    return parseImportFile(file_path, keyboard_type);
+  }
+  KeyboardType keyboard_type;
+};
+
+}  // namespace
+
+QStringList findImportFiles(const QString& dir_path) {
+  TraceSpan span("findImportFiles");
+  QStringList name_filters;
+  for (auto pattern : kImportFilePatterns) {
+    name_filters.append(pattern);
+  }
+  QStringList file_paths;
+  QDirIterator it(dir_path, name_filters, QDir::Files, QDirIterator::Subdirectories);
+  while (it.hasNext()) {
+    file_paths.append(it.next());
+  }
+  file_paths.sort();
+  return file_paths;
+}
+
+ImportFileResult parseImportFile(const QString& file_path, KeyboardType keyboard_type) {
+  ImportFileResult result;
+  result.file_path = file_path;
+  auto suffix = QFileInfo(file_path).suffix().toLower();
+  if (suffix == "reg") {
+    parseRegFile(file_path, keyboard_type, &result);
+  } else if (suffix == "ini") {
+    parseIniFile(file_path, keyboard_type, &result);
+  } else {
+    parseHexFile(file_path, keyboard_type, &result);
+  }
+  if (!result.error.isEmpty()) {
+    result.key_maps.clear();
+    // Other text files may share the directory with the hex dumps
+    result.skipped = suffix == "txt";
+  }
+  return result;
+}
+
+QFuture<ImportFileResult> parseImportFiles(const QStringList& file_paths,
+                                           KeyboardType keyboard_type) {
+  return QtConcurrent::mapped(file_paths, ImportFileParser{keyboard_type});
+}
+
+ImportPlan planImport(const QList<ImportFileResult>& results, const ProfileStore& profile_store) {
+  TraceSpan span("planImport");
+  ImportPlan plan;
+  plan.file_count = results.count();
+  // Names are looked up through hashes, as imports can be large
+  QHash<QString, int> saved_names;
+  saved_names.reserve(profile_store.count());
+  for (int idx = 0; idx < profile_store.count(); ++ idx) {
+    saved_names.insert(profile_store.getName(idx), idx);
+  }
+  QHash<QString, int> planned_names;
+  QMultiHash<quint64, int> planned_hashes;
+  QList<QList<KeyMapEntry>> planned_canonical_key_maps;
+  for (auto& result : results) {
+    auto file_path = QDir::toNativeSeparators(result.file_path);
+    if (result.skipped) {
+      plan.skipped_files.append(QString("%1: %2").arg(file_path, result.error));
+      continue;
+    } else if (!result.error.isEmpty()) {
+      plan.errors.append(QString("%1: %2").arg(file_path, result.error));
+      continue;
+    }
+    for (auto& key_map : result.key_maps) {
+      auto label = QString("'%1' (%2)").arg(key_map.name, file_path);
+      auto canonical_key_map = getCanonicalKeyMap(key_map.key_map);
+      auto saved = saved_names.constFind(key_map.name);
+      if (saved != saved_names.constEnd()) {
+        if (getCanonicalKeyMap(profile_store.getKeyMap(*saved).key_map) == canonical_key_map) {
+          plan.duplicates.append(label + ": already saved");
+        } else {
+          plan.conflicts.append(label + ": differs from the saved key map of the same name");
+        }
+        continue;
+      }
+      auto planned = planned_names.constFind(key_map.name);
+      if (planned != planned_names.constEnd()) {
+        if (planned_canonical_key_maps[*planned] == canonical_key_map) {
+          plan.duplicates.append(label + ": imported from another file");
+        } else {
+          plan.conflicts.append(label + ": differs from an imported key map of the same name");
+        }
+        continue;
+      }
+      auto saved_name = profile_store.findNameOf(key_map.key_map);
+      if (!saved_name.isEmpty()) {
+        plan.duplicates.append(label + QString(": same as saved '%1'").arg(saved_name));
+        continue;
+      }
+      auto hash = getKeyMapHash(key_map.key_map);
+      int same_idx = -1;
+      for (auto it = planned_hashes.constFind(hash);
+           it != planned_hashes.constEnd() && it.key() == hash; ++ it) {
+        if (planned_canonical_key_maps[*it] == canonical_key_map) {
+          same_idx = *it;
+          break;
+        }
+      }
+      if (same_idx >= 0) {
+        plan.duplicates.append(label + QString(": same as imported '%1'")
+                               .arg(plan.key_maps[same_idx].name));
+        continue;
+      }
+      planned_names.insert(key_map.name, plan.key_maps.count());
+      planned_hashes.insert(hash, plan.key_maps.count());
+      planned_canonical_key_maps.append(canonical_key_map);
+      plan.key_maps.append(key_map);
+    }
+  }
+  return plan;
+}
+
+QString describeImportPlan(const ImportPlan& plan) {
+  return QString("%1 files: %2 key maps to import, %3 duplicates, %4 conflicts, %5 errors, "
+                 "%6 skipped files")
+      .arg(plan.file_count).arg(plan.key_maps.count()).arg(plan.duplicates.count())
+      .arg(plan.conflicts.count()).arg(plan.errors.count()).arg(plan.skipped_files.count());
+}
+
+QString describeImportDetails(const ImportPlan& plan) {
+  QStringList lines;
+  for (auto& conflict : plan.conflicts) {
+    lines.append("Conflict: " + conflict);
+  }
+  for (auto& duplicate : plan.duplicates) {
+    lines.append("Duplicate: " + duplicate);
+  }
+  for (auto& error : plan.errors) {
+    lines.append("Error: " + error);
+  }
+  for (auto& skipped_file : plan.skipped_files) {
+    lines.append("Skipped: " + skipped_file);
+  }
+  return lines.join("\n");
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <QFuture>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include "keymap.hpp"
+
+class ProfileStore;
+
+// Bulk import of key maps from a directory tree. Supported files are
+//   *.reg        : registry exports holding "Scancode Map" values, named
+//                  after the file, or after their keys if written by
+//                  exportKeyMaps()
+//   *.hex, *.txt : hex dumps of Scancode Map values as printed by --export,
+//                  named by "[name]" lines or after the file. A *.txt
+//                  file which isn't one, such as a README, is skipped.
+//   *.ini        : fragments of keysetup.ini
+// Files are parsed in parallel, then checked against each other and the
+// profile store before anything is added.
+
+struct ImportFileResult {
+  QString file_path;
+  QList<KeyMap> key_maps;
+  QString error;
+  // The file isn't a key map file, and error tells why
+  bool skipped = false;
+};
+
+struct ImportPlan {
+  int file_count = 0;
+  // Key maps to add, in file path order
+  QList<KeyMap> key_maps;
+  // Key maps skipped because the same one is saved or imported already
+  QStringList duplicates;
+  // Key maps skipped because another key map has the same name
+  QStringList conflicts;
+  QStringList errors;
+  // Files which aren't key map files
+  QStringList skipped_files;
+};
+
+// Returns the supported files under dir_path, sorted by path
+QStringList findImportFiles(const QString& dir_path);
+
+// Returns result of a single file. keyboard_type is used for files which
+// don't specify one.
+ImportFileResult parseImportFile(const QString& file_path, KeyboardType keyboard_type);
+
+// Parses the files on the global thread pool. Results are in the order
+// of file_paths.
+QFuture<ImportFileResult> parseImportFiles(const QStringList& file_paths,
+                                           KeyboardType keyboard_type);
+
+// Deduplicates the parsed key maps by content and checks them for name
+// conflicts
+ImportPlan planImport(const QList<ImportFileResult>& results, const ProfileStore& profile_store);
+
+// Returns a one-line summary of plan
+QString describeImportPlan(const ImportPlan& plan);
+// Returns the skipped key maps and files and the errors of plan, one per
+// line
+QString describeImportDetails(const ImportPlan& plan);
@@ -0,0 +1,209 @@
+#include "keymaptablemodel.hpp"
+
+#include <QColor>
+
+#include "keymapanalyzer.hpp"
+
+namespace {
+
+const QColor kErrorBackground(255, 200, 200);
+const QColor kWarningBackground(255, 240, 200);
+
+}  // namespace
+
+KeyMapTableModel::KeyMapTableModel(QObject* parent)
+    : QAbstractTableModel(parent) {
+}
+
+int KeyMapTableModel::rowCount(const QModelIndex& parent) const {
+  return parent.isValid() ? 0 : key_map_.count();
+}
+
+int KeyMapTableModel::columnCount(const QModelIndex& parent) const {
+  return parent.isValid() ? 0 : kColumnCount;
+}
+
+QVariant KeyMapTableModel::data(const QModelIndex& index, int role) const {
+  if (!index.isValid()) {
+    return QVariant();
+  }
+  auto& entry = key_map_[index.row()];
+  auto issues = entry_issues_[index.row()];
+  if (role == Qt::BackgroundRole && issues != kNoIssue) {
+    return (issues & kKeyMapErrors) ? kErrorBackground : kWarningBackground;
+  } else if (role == Qt::ToolTipRole && issues != kNoIssue) {
+    return describeKeyMapIssues(issues);
+  }
+  switch (index.column()) {
+    case kCheckColumn:
+      if (role == Qt::CheckStateRole) {
+        return checked_[index.row()] ? Qt::Checked : Qt::Unchecked;
+      }
+      break;
+    case kActualKeyColumn:
+    case kMapToKeyColumn: {
+      auto scan_code = index.column() == kActualKeyColumn ? entry.actual_key : entry.map_to_key;
+      bool defined = isKeyDefined(keyboard_type_, scan_code);
+      if (role == Qt::DisplayRole) {
+        return defined
+            ? getKeyNameOf(keyboard_type_, scan_code)
+            : "0x" + QString("%1").arg(scan_code, 4, 16, QChar('0')).toUpper();
+      } else if (role == Qt::EditRole) {
+        return static_cast<uint>(scan_code);
+      } else if (role == Qt::ForegroundRole && !defined) {
+        return QColor(Qt::red);
+      }
+      break;
+    }
+  }
+  return QVariant();
+}
+
+bool KeyMapTableModel::setData(const QModelIndex& index, const QVariant& value, int role) {
+  if (!index.isValid()) {
+    return false;
+  }
+  auto& entry = key_map_[index.row()];
+  if (index.column() == kCheckColumn && role == Qt::CheckStateRole) {
+    bool checked = value.toInt() == Qt::Checked;
+    if (checked != checked_[index.row()]) {
+      checked_count_ += checked ? 1 : -1;
+    }
+    checked_[index.row()] = checked;
+  } else if (index.column() == kActualKeyColumn && role == Qt::EditRole) {
+    auto scan_code = static_cast<uint16_t>(value.toUInt());
+    // Every closed editor commits, which isn't an edit unless the key differs
+    if (scan_code == entry.actual_key) {
+      return true;
+    }
+    entry.actual_key = scan_code;
+    snapshot_ = snapshot_.set(index.row(), entry);
+  } else if (index.column() == kMapToKeyColumn && role == Qt::EditRole) {
+    auto scan_code = static_cast<uint16_t>(value.toUInt());
+    if (scan_code == entry.map_to_key) {
+      return true;
+    }
+    entry.map_to_key = scan_code;
+    snapshot_ = snapshot_.set(index.row(), entry);
+  } else {
+    return false;
+  }
+  emit dataChanged(index, index, {role});
+  return true;
+}
+
+Qt::ItemFlags KeyMapTableModel::flags(const QModelIndex& index) const {
+  if (!index.isValid()) {
+    return Qt::NoItemFlags;
+  }
+  if (index.column() == kCheckColumn) {
+    return Qt::ItemIsEnabled | Qt::ItemIsUserCheckable;
+  }
+  return Qt::ItemIsEnabled | Qt::ItemIsEditable;
+}
+
+QVariant KeyMapTableModel::headerData(int section, Qt::Orientation orientation,
+                                      int role) const {
+  if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+    return QAbstractTableModel::headerData(section, orientation, role);
+  }
+  switch (section) {
+    case kActualKeyColumn:
+      return "Actual key";
+    case kMapToKeyColumn:
+      return "Map to key";
+    default:
+      return "";
+  }
+}
+
+KeyboardType KeyMapTableModel::getKeyboardType() const {
+  return keyboard_type_;
+}
+
+const QList<KeyMapEntry>& KeyMapTableModel::getKeyMap() const {
+  return key_map_;
+}
+
+void KeyMapTableModel::setKeyMap(KeyboardType keyboard_type, const QList<KeyMapEntry>& key_map) {
+  setKeyMap(keyboard_type, PersistentKeyMap(key_map));
+}
+
+void KeyMapTableModel::setKeyMap(KeyboardType keyboard_type, const PersistentKeyMap& snapshot) {
+  beginResetModel();
+  keyboard_type_ = keyboard_type;
+  key_map_ = snapshot.toList();
+  snapshot_ = snapshot;
+  checked_.fill(false, key_map_.count());
+  checked_count_ = 0;
+  entry_issues_.fill(kNoIssue, key_map_.count());
+  endResetModel();
+}
+
+const PersistentKeyMap& KeyMapTableModel::getSnapshot() const {
+  return snapshot_;
+}
+
+void KeyMapTableModel::setKeyboardType(KeyboardType keyboard_type) {
+  keyboard_type_ = keyboard_type;
+  if (!key_map_.isEmpty()) {
+    emit dataChanged(index(0, kActualKeyColumn), index(key_map_.count() - 1, kMapToKeyColumn),
+                     {Qt::DisplayRole, Qt::ForegroundRole});
+  }
+}
+
+void KeyMapTableModel::appendEntry(const KeyMapEntry& entry) {
+  auto row = key_map_.count();
+  beginInsertRows(QModelIndex(), row, row);
+  key_map_.append(entry);
+  snapshot_ = snapshot_.append(entry);
+  checked_.append(false);
+  entry_issues_.append(kNoIssue);
+  endInsertRows();
+}
+
+bool KeyMapTableModel::hasCheckedEntry() const {
+  return checked_count_ > 0;
+}
+
+void KeyMapTableModel::setEntryIssues(const QVector<int>& entry_issues) {
+  // Notify runs of rows whose issues have changed
+  int first_row = -1;
+  for (int row = 0; row <= key_map_.count(); ++ row) {
+    bool changed = row < key_map_.count() && entry_issues_[row] != entry_issues.value(row);
+    if (changed) {
+      entry_issues_[row] = entry_issues.value(row);
+      if (first_row < 0) {
+        first_row = row;
+      }
+    } else if (first_row >= 0) {
+      emit dataChanged(index(first_row, 0), index(row - 1, kColumnCount - 1),
+                       {Qt::BackgroundRole, Qt::ToolTipRole});
+      first_row = -1;
+    }
+  }
+}
+
+void KeyMapTableModel::removeCheckedEntries() {
+  // Remove runs of checked rows from the bottom, one notification per run
+  int last_row = key_map_.count() - 1;
+  while (last_row >= 0) {
+    if (!checked_[last_row]) {
+      -- last_row;
+      continue;
+    }
+    int first_row = last_row;
+    while (first_row > 0 && checked_[first_row - 1]) {
+      -- first_row;
+    }
+    beginRemoveRows(QModelIndex(), first_row, last_row);
+    key_map_.erase(key_map_.begin() + first_row, key_map_.begin() + last_row + 1);
+    checked_.remove(first_row, last_row - first_row + 1);
+    checked_count_ -= last_row - first_row + 1;
+    entry_issues_.remove(first_row, last_row - first_row + 1);
+    endRemoveRows();
+    last_row = first_row - 1;
+  }
+  // Removal shifts the rows after it, so the snapshot is rebuilt once
+  snapshot_ = PersistentKeyMap(key_map_);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <QAbstractTableModel>
+#include <QList>
+#include <QVector>
+
+#include "keyboarddefs.hpp"
+#include "persistentkeymap.hpp"
+#include "scancodemap.hpp"
+
+// Key map being edited in EditKeyMapDialog. The key columns show key
+// names of the keyboard type and hold scan codes as edit data.
+// Scan codes which the keyboard type doesn't define are kept and shown
+// as hex in red. Rows with issues found by analyzeKeyMap() are
+// highlighted. Every change is mirrored into a PersistentKeyMap, so a
+// snapshot of the entries can be taken in O(1).
+class KeyMapTableModel : public QAbstractTableModel {
+  Q_OBJECT
+ public:
+  enum Column {
+    kCheckColumn,
+    kActualKeyColumn,
+    kMapToKeyColumn,
+    kColumnCount
+  };
+
+  KeyMapTableModel(QObject* parent = nullptr);
+
+  int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+  int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+  QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+  bool setData(const QModelIndex& index, const QVariant& value, int role = Qt::EditRole) override;
+  Qt::ItemFlags flags(const QModelIndex& index) const override;
+  QVariant headerData(int section, Qt::Orientation orientation,
+                      int role = Qt::DisplayRole) const override;
+
+  KeyboardType getKeyboardType() const;
+  const QList<KeyMapEntry>& getKeyMap() const;
+  void setKeyMap(KeyboardType keyboard_type, const QList<KeyMapEntry>& key_map);
+  // Restores a snapshot taken by getSnapshot()
+  void setKeyMap(KeyboardType keyboard_type, const PersistentKeyMap& snapshot);
+  const PersistentKeyMap& getSnapshot() const;
+  // Relabels the key columns in place
+  void setKeyboardType(KeyboardType keyboard_type);
+  void appendEntry(const KeyMapEntry& entry);
+  bool hasCheckedEntry() const;
+  // Sets KeyMapIssue flags of each entry
+  void setEntryIssues(const QVector<int>& entry_issues);
+  void removeCheckedEntries();
+
+ private:
+  KeyboardType keyboard_type_ = KeyboardType::kUS;
+  QList<KeyMapEntry> key_map_;
+  PersistentKeyMap snapshot_;
+  QVector<bool> checked_;
+  QVector<int> entry_issues_;
+  int checked_count_ = 0;
+};
@@ -0,0 +1,65 @@
+#include "keynameindex.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+void KeyNameIndex::setKeyboardType(KeyboardType keyboard_type) {
+  key_names_ = getKeyNames(keyboard_type);
+  scan_codes_.clear();
+  row_of_scan_code_.clear();
+  row_of_key_name_.clear();
+  QStringList folded_names;
+  for (int row = 0; row < key_names_.count(); ++ row) {
+    auto scan_code = getScanCodeOf(keyboard_type, key_names_[row]);
+    scan_codes_.push_back(scan_code);
+    // The first key of a scan code is the one the table shows
+    if (!row_of_scan_code_.contains(scan_code)) {
+      row_of_scan_code_.insert(scan_code, row);
+    }
+    row_of_key_name_.insert(key_names_[row], row);
+    folded_names.append(key_names_[row].toCaseFolded());
+  }
+
+  sorted_rows_.resize(key_names_.count());
+  std::iota(sorted_rows_.begin(), sorted_rows_.end(), 0);
+  std::stable_sort(sorted_rows_.begin(), sorted_rows_.end(), [&](int lhs, int rhs) {
+    return folded_names[lhs] < folded_names[rhs];
+  });
+  folded_names_.clear();
+  for (auto row : sorted_rows_) {
+    folded_names_.append(folded_names[row]);
+  }
+}
+
+int KeyNameIndex::count() const {
+  return key_names_.count();
+}
+
+const QStringList& KeyNameIndex::getKeyNames() const {
+  return key_names_;
+}
+
+uint16_t KeyNameIndex::getScanCodeAt(int row) const {
+  return scan_codes_[row];
+}
+
+int KeyNameIndex::getRowOf(uint16_t scan_code) const {
+  return row_of_scan_code_.value(scan_code, -1);
+}
+
+int KeyNameIndex::getRowOf(const QString& key_name) const {
+  return row_of_key_name_.value(key_name, -1);
+}
+
+QStringList KeyNameIndex::findKeyNames(const QString& prefix) const {
+  if (prefix.isEmpty()) {
+    return key_names_;
+  }
+  auto folded_prefix = prefix.toCaseFolded();
+  auto first = std::lower_bound(folded_names_.begin(), folded_names_.end(), folded_prefix);
+  QStringList key_names;
+  for (auto it = first; it != folded_names_.end() && it->startsWith(folded_prefix); ++ it) {
+    key_names.append(key_names_[sorted_rows_[it - folded_names_.begin()]]);
+  }
+  return key_names;
+}
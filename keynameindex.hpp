@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+#include "keyboarddefs.hpp"
+
+// Search index of the key names of a keyboard type, shared by all the key
+// selectors of the key map table. Lookups by scan code and by name are
+// O(1), and prefix searches are binary searches over the names sorted
+// case-insensitively, so they don't grow with the size of the layout.
+class KeyNameIndex {
+ public:
+  void setKeyboardType(KeyboardType keyboard_type);
+
+  int count() const;
+  // Key names in the order of the layout
+  const QStringList& getKeyNames() const;
+  uint16_t getScanCodeAt(int row) const;
+  // Return the row of the key, or -1 if there is none
+  int getRowOf(uint16_t scan_code) const;
+  int getRowOf(const QString& key_name) const;
+  // Returns the key names which start with prefix, ignoring case, sorted
+  // by name. An empty prefix returns all names in the order of the layout.
+  QStringList findKeyNames(const QString& prefix) const;
+
+ private:
+  QStringList key_names_;
+  std::vector<uint16_t> scan_codes_;
+  QHash<uint16_t, int> row_of_scan_code_;
+  QHash<QString, int> row_of_key_name_;
+  // Case-folded names and their rows, sorted by the folded name
+  QStringList folded_names_;
+  std::vector<int> sorted_rows_;
+};
@@ -0,0 +1,103 @@
+#include "keyselectdelegate.hpp"
+
+#include <QAbstractItemView>
+#include <QApplication>
+#include <QCompleter>
+#include <QLineEdit>
+#include <QPainter>
+#include <QStyle>
+#include <QStringListModel>
+#include <QStyleOptionComboBox>
+#include <QTimer>
+
+KeySelectDelegate::KeySelectDelegate(const KeyNameIndex* key_name_index, QObject* parent)
+    : QStyledItemDelegate(parent),
+      key_name_index_(key_name_index) {
+}
+
+void KeySelectDelegate::paint(QPainter* painter, const QStyleOptionViewItem& option,
+                              const QModelIndex& index) const {
+  // Rows with issues keep their background around the combo box
+  auto background = index.data(Qt::BackgroundRole);
+  QStyleOptionComboBox combo_option;
+  combo_option.rect = option.rect;
+  if (background.canConvert<QColor>()) {
+    painter->fillRect(option.rect, background.value<QColor>());
+    combo_option.rect = option.rect.adjusted(2, 2, -2, -2);
+  }
+  combo_option.direction = option.direction;
+  combo_option.fontMetrics = option.fontMetrics;
+  combo_option.state = option.state | QStyle::State_Enabled;
+  combo_option.palette = option.palette;
+  auto foreground = index.data(Qt::ForegroundRole);
+  if (foreground.canConvert<QColor>()) {
+    combo_option.palette.setColor(QPalette::ButtonText, foreground.value<QColor>());
+    combo_option.palette.setColor(QPalette::Text, foreground.value<QColor>());
+  }
+  combo_option.currentText = index.data(Qt::DisplayRole).toString();
+  auto style = option.widget ? option.widget->style() : QApplication::style();
+  painter->save();
+  style->drawComplexControl(QStyle::CC_ComboBox, &combo_option, painter, option.widget);
+  style->drawControl(QStyle::CE_ComboBoxLabel, &combo_option, painter, option.widget);
+  painter->restore();
+}
+
+QWidget* KeySelectDelegate::createEditor(QWidget* parent, const QStyleOptionViewItem&,
+                                         const QModelIndex&) const {
+  auto key_input = new QLineEdit(parent);
+  auto key_name_list = new QStringListModel(key_input);
+  auto completer = new QCompleter(key_name_list, key_input);
+  // The list is filtered by the index, not by the completer
+  completer->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
+  completer->setMaxVisibleItems(20);
+  key_input->setCompleter(completer);
+  connect(key_input, &QLineEdit::textEdited, completer, [=](const QString& text) {
+    key_name_list->setStringList(key_name_index_->findKeyNames(text));
+    completer->complete();
+  });
+  connect(completer, qOverload<const QString&>(&QCompleter::activated),
+          this, &KeySelectDelegate::commitAndCloseEditor_);
+  return key_input;
+}
+
+void KeySelectDelegate::setEditorData(QWidget* editor, const QModelIndex& index) const {
+  auto key_input = qobject_cast<QLineEdit*>(editor);
+  auto completer = key_input->completer();
+  auto row = key_name_index_->getRowOf(static_cast<uint16_t>(index.data(Qt::EditRole).toUInt()));
+  key_input->setText(row >= 0 ? key_name_index_->getKeyNames()[row] : QString());
+  key_input->selectAll();
+  // Open the whole list at the current key, as clicking a combo box does
+  static_cast<QStringListModel*>(completer->model())->setStringList(
+      key_name_index_->getKeyNames());
+  QTimer::singleShot(0, completer, [=] {
+    completer->complete();
+    if (row >= 0) {
+      completer->popup()->setCurrentIndex(completer->completionModel()->index(row, 0));
+    }
+  });
+}
+
+void KeySelectDelegate::setModelData(QWidget* editor, QAbstractItemModel* model,
+                                     const QModelIndex& index) const {
+  // An exact name, or else the first name starting with the text
+  auto text = qobject_cast<QLineEdit*>(editor)->text();
+  auto row = key_name_index_->getRowOf(text);
+  if (row < 0 && !text.isEmpty()) {
+    auto key_names = key_name_index_->findKeyNames(text);
+    row = key_names.isEmpty() ? -1 : key_name_index_->getRowOf(key_names.front());
+  }
+  if (row >= 0) {
+    model->setData(index, static_cast<uint>(key_name_index_->getScanCodeAt(row)), Qt::EditRole);
+  }
+}
+
+void KeySelectDelegate::updateEditorGeometry(QWidget* editor, const QStyleOptionViewItem& option,
+                                             const QModelIndex&) const {
+  editor->setGeometry(option.rect);
+}
+
+void KeySelectDelegate::commitAndCloseEditor_() {
+  auto editor = qobject_cast<QCompleter*>(sender())->widget();
+  emit commitData(editor);
+  emit closeEditor(editor);
+}
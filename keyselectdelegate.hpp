@@ -0,0 +1,31 @@
+#pragma once
+
+#include <QStyledItemDelegate>
+
+#include "keynameindex.hpp"
+
+// Draws key cells of the key map table like a combo box, and creates an
+// editor only while a cell is being edited. The editor is a typeahead:
+// its list shows the key names starting with the typed text. All editors
+// share key_name_index, which the owner keeps up to date.
+class KeySelectDelegate : public QStyledItemDelegate {
+  Q_OBJECT
+ public:
+  KeySelectDelegate(const KeyNameIndex* key_name_index, QObject* parent = nullptr);
+
+  void paint(QPainter* painter, const QStyleOptionViewItem& option,
+             const QModelIndex& index) const override;
+  QWidget* createEditor(QWidget* parent, const QStyleOptionViewItem& option,
+                        const QModelIndex& index) const override;
+  void setEditorData(QWidget* editor, const QModelIndex& index) const override;
+  void setModelData(QWidget* editor, QAbstractItemModel* model,
+                    const QModelIndex& index) const override;
+  void updateEditorGeometry(QWidget* editor, const QStyleOptionViewItem& option,
+                            const QModelIndex& index) const override;
+
+ private slots:
+  void commitAndCloseEditor_();
+
+ private:
+  const KeyNameIndex* key_name_index_;
+};
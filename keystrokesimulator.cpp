@@ -0,0 +1,145 @@
+#include "keystrokesimulator.hpp"
+
+#include <algorithm>
+#include <bitset>
+#include <numeric>
+
+#include <QVector>
+#include <QtConcurrent>
+
+namespace {
+
+const int kScanCodeCount = 0x10000;
+// Keystrokes per task of the thread pool
+const qint64 kBatchSize = 1 << 20;
+// Keystrokes translated at once into a buffer which stays in L1 cache
+const int kBlockSize = 4096;
+
+struct Batch {
+  qint64 begin;
+  qint64 end;
+  KeyStrokeStats stats;
+};
+
+// Counts differing scan codes. Kept apart from the table lookups so that
+// the compiler can vectorize it.
+qint64 countDifferences(const uint16_t* lhs, const uint16_t* rhs, int count) {
+  qint64 difference_count = 0;
+  for (int idx = 0; idx < count; ++ idx) {
+    difference_count += lhs[idx] != rhs[idx];
+  }
+  return difference_count;
+}
+
+void simulateBatch(const KeyStrokeSimulator& simulator, const uint16_t* input,
+                   const uint16_t* expected, Batch* batch) {
+  uint16_t output[kBlockSize];
+  auto& stats = batch->stats;
+  for (auto block_begin = batch->begin; block_begin < batch->end; block_begin += kBlockSize) {
+    auto block_size = static_cast<int>(std::min<qint64>(kBlockSize, batch->end - block_begin));
+    simulator.translate(input + block_begin, output, block_size);
+    stats.remapped_count += countDifferences(input + block_begin, output, block_size);
+    if (expected == nullptr) {
+      continue;
+    }
+    auto mismatch_count = countDifferences(expected + block_begin, output, block_size);
+    if (mismatch_count > 0 && stats.first_mismatch < 0) {
+      auto mismatch = std::mismatch(output, output + block_size, expected + block_begin);
+      stats.first_mismatch = block_begin + (mismatch.first - output);
+    }
+    stats.mismatch_count += mismatch_count;
+  }
+  stats.keystroke_count = batch->end - batch->begin;
+}
+
+}  // namespace
+
+KeyStrokeSimulator::KeyStrokeSimulator(const QList<KeyMapEntry>& key_map)
+    : lut_(kScanCodeCount) {
+  std::iota(lut_.begin(), lut_.end(), 0);
+  std::bitset<kScanCodeCount> remapped;
+  for (auto& entry : key_map) {
+    if (!remapped.test(entry.actual_key)) {
+      remapped.set(entry.actual_key);
+      lut_[entry.actual_key] = entry.map_to_key;
+    }
+  }
+}
+
+void KeyStrokeSimulator::translate(const uint16_t* input, uint16_t* output,
+                                   qint64 count) const {
+  auto lut = lut_.data();
+  for (qint64 idx = 0; idx < count; ++ idx) {
+    output[idx] = lut[input[idx]];
+  }
+}
+
+KeyStrokeStream::~KeyStrokeStream() {
+  close();
+}
+
+QString KeyStrokeStream::open(const QString& file_path) {
+  close();
+  if (Q_BYTE_ORDER != Q_LITTLE_ENDIAN) {
+    return "Keystroke streams can be replayed only on little endian hosts";
+  }
+  file_.setFileName(file_path);
+  if (!file_.open(QIODevice::ReadOnly)) {
+    return "Open keystroke stream failed";
+  }
+  auto size = file_.size();
+  if (size % sizeof(uint16_t) != 0) {
+    close();
+    return "Keystroke stream is truncated";
+  }
+  if (size > 0) {
+    // A mapping starts at a page boundary, so the scan codes are aligned
+    data_ = reinterpret_cast<const uint16_t*>(file_.map(0, size));
+    if (data_ == nullptr) {
+      close();
+      return "Map keystroke stream failed";
+    }
+  }
+  count_ = size / sizeof(uint16_t);
+  return QString();
+}
+
+void KeyStrokeStream::close() {
+  if (data_) {
+    file_.unmap(reinterpret_cast<uchar*>(const_cast<uint16_t*>(data_)));
+    data_ = nullptr;
+  }
+  count_ = 0;
+  file_.close();
+}
+
+const uint16_t* KeyStrokeStream::getData() const {
+  return data_;
+}
+
+qint64 KeyStrokeStream::count() const {
+  return count_;
+}
+
+KeyStrokeStats simulateKeyStrokes(const KeyStrokeSimulator& simulator,
+                                  const uint16_t* input, qint64 count,
+                                  const uint16_t* expected) {
+  QVector<Batch> batches;
+  for (qint64 begin = 0; begin < count; begin += kBatchSize) {
+    batches.append({begin, std::min(begin + kBatchSize, count), {}});
+  }
+  QtConcurrent::blockingMap(batches, [&](Batch& batch) {
+    simulateBatch(simulator, input, expected, &batch);
+  });
+
+  KeyStrokeStats stats;
+  for (auto& batch : batches) {
+    stats.keystroke_count += batch.stats.keystroke_count;
+    stats.remapped_count += batch.stats.remapped_count;
+    stats.mismatch_count += batch.stats.mismatch_count;
+    if (stats.first_mismatch < 0) {
+      stats.first_mismatch = batch.stats.first_mismatch;
+    }
+  }
+  return stats;
+}
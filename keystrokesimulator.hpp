@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <QFile>
+#include <QList>
+#include <QString>
+
+#include "scancodemap.hpp"
+
+// Replays recorded keystrokes through a key map as Windows applies a
+// Scancode Map: every scan code is translated once through a 64K table,
+// and chains are not followed. The first entry of an actual key is used.
+class KeyStrokeSimulator {
+ public:
+  explicit KeyStrokeSimulator(const QList<KeyMapEntry>& key_map);
+
+  uint16_t translate(uint16_t scan_code) const {
+    return lut_[scan_code];
+  }
+  // Translates count scan codes of input into output
+  void translate(const uint16_t* input, uint16_t* output, qint64 count) const;
+
+ private:
+  std::vector<uint16_t> lut_;
+};
+
+struct KeyStrokeStats {
+  qint64 keystroke_count = 0;
+  // Keystrokes which the key map changes
+  qint64 remapped_count = 0;
+  // Keystrokes which differ from the expected stream
+  qint64 mismatch_count = 0;
+  // Position of the first mismatch, or -1
+  qint64 first_mismatch = -1;
+};
+
+// Read-only view of a recorded keystroke stream file, which holds 16-bit
+// little endian scan codes (0xE0XX for extended keys) with no header. The
+// file is memory-mapped, so streams larger than memory can be replayed.
+class KeyStrokeStream {
+ public:
+  KeyStrokeStream() = default;
+  KeyStrokeStream(const KeyStrokeStream&) = delete;
+  KeyStrokeStream& operator=(const KeyStrokeStream&) = delete;
+  ~KeyStrokeStream();
+
+  // Returns error message
+  QString open(const QString& file_path);
+  void close();
+
+  const uint16_t* getData() const;
+  qint64 count() const;
+
+ private:
+  QFile file_;
+  const uint16_t* data_ = nullptr;
+  qint64 count_ = 0;
+};
+
+// Translates input in batches on the global thread pool and counts the
+// keystrokes which are remapped, and which differ from expected when it
+// is given. expected must have count scan codes.
+KeyStrokeStats simulateKeyStrokes(const KeyStrokeSimulator& simulator,
+                                  const uint16_t* input, qint64 count,
+                                  const uint16_t* expected = nullptr);
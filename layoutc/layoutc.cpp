@@ -0,0 +1,32 @@
+//
+// Layout pack compiler: layoutc <source> <pack>
+//
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QTextStream>
+
+#include "layoutpack.hpp"
+
+int main(int argc, char* argv[]) {
+  QCoreApplication app(argc, argv);
+  QTextStream err(stderr);
+  auto args = app.arguments();
+  if (args.count() != 3) {
+    err << "Usage: layoutc <source> <pack>\n";
+    return 2;
+  }
+  auto& source_path = args[1];
+  auto& pack_path = args[2];
+  if (!QFileInfo(pack_path).dir().mkpath(".")) {
+    err << QString("Create directory of '%1' failed\n").arg(pack_path);
+    return 1;
+  }
+  auto err_msg = compileLayoutPack(source_path, pack_path);
+  if (!err_msg.isEmpty()) {
+    err << source_path << ": " << err_msg << "\n";
+    return 1;
+  }
+  return 0;
+}
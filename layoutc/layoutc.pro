@@ -0,0 +1,19 @@
+# Host tool which compiles layout sources into layout packs for
+# SetKeyMap.pro. It needs only QtCore, so it can be built for the build
+# machine when SetKeyMap is cross-compiled.
+TEMPLATE = app
+TARGET = layoutc
+# The same path in every configuration, as SetKeyMap.pro runs it from here
+DESTDIR = $$OUT_PWD
+INCLUDEPATH += . ..
+QT -= gui
+CONFIG += c++17 console
+CONFIG -= app_bundle
+DEFINES += QT_DEPRECATED_WARNINGS
+HEADERS += \
+        ../keyboarddefs.hpp \
+        ../layoutpack.hpp
+SOURCES += \
+        layoutc.cpp \
+        ../keyboarddefs.cpp \
+        ../layoutpack.cpp
@@ -0,0 +1,245 @@
+#include "layoutpack.hpp"
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRegExp>
+#include <QSaveFile>
+#include <QSet>
+#include <QTextStream>
+#include <QtEndian>
+
+namespace {
+
+const char kMagic[4] = {'S', 'K', 'L', 'P'};
+const quint32 kVersion = 1;
+const int kHeaderSize = 12;
+const int kKeyEntrySize = 8;
+
+struct LayoutKey {
+  uint16_t scan_code;
+  QString key_name;
+};
+
+QString getLayoutPackDir() {
+  auto layout_dir = qEnvironmentVariable("SETKEYMAP_LAYOUT_DIR");
+  if (layout_dir.isEmpty()) {
+    layout_dir = QDir(QCoreApplication::applicationDirPath()).filePath("layouts");
+  }
+  return layout_dir;
+}
+
+// Loaded packs, indexed as getLayoutPackNames(). Packs are never unloaded,
+// so the pointers stay valid.
+struct LayoutPackCache {
+  QMutex mutex;
+  std::vector<std::unique_ptr<LayoutPack>> packs;
+  std::vector<bool> loaded;
+};
+
+LayoutPackCache& getLayoutPackCache() {
+  static LayoutPackCache cache;
+  return cache;
+}
+
+QString readLayoutSource(const QString& source_path, QList<LayoutKey>* keys) {
+  QFile file(source_path);
+  if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    return "Open layout source failed";
+  }
+  QTextStream in(&file);
+  in.setCodec("UTF-8");
+  QList<LayoutKey> result;
+  int line_number = 0;
+  while (!in.atEnd()) {
+    auto line = in.readLine().trimmed();
+    ++ line_number;
+    if (line.isEmpty() || line.startsWith('#')) {
+      continue;
+    }
+    auto separator = line.indexOf(QRegExp("\\s"));
+    auto first_word = line.left(separator);
+    auto rest = separator < 0 ? QString() : line.mid(separator).trimmed();
+    if (first_word == "base") {
+      if (!result.isEmpty() || (rest != "US" && rest != "JP")) {
+        return QString("Line %1: base must be the first key and US or JP").arg(line_number);
+      }
+      auto base_type = getKeyboardTypeFromString(rest);
+      for (auto& key_name : getKeyNames(base_type)) {
+        result.append({getScanCodeOf(base_type, key_name), key_name});
+      }
+      continue;
+    }
+    bool ok = false;
+    auto scan_code = first_word.toUInt(&ok, 16);
+    if (!ok || scan_code == 0 || scan_code > 0xFFFF) {
+      return QString("Line %1: invalid scan code '%2'").arg(line_number).arg(first_word);
+    }
+    // Replace the keys of the scan code, or add it
+    bool replaced = false;
+    for (int idx = result.count() - 1; idx >= 0; -- idx) {
+      if (result[idx].scan_code == scan_code) {
+        result[idx].key_name = rest;
+        replaced = true;
+      }
+    }
+    if (!replaced) {
+      result.append({static_cast<uint16_t>(scan_code), rest});
+    }
+  }
+  // Drop removed keys and repeated names, the first one wins
+  QSet<QString> key_names;
+  keys->clear();
+  for (auto& key : result) {
+    if (!key.key_name.isEmpty() && !key_names.contains(key.key_name)) {
+      key_names.insert(key.key_name);
+      keys->append(key);
+    }
+  }
+  return QString();
+}
+
+}  // namespace
+
+QString LayoutPack::open(const QString& file_path) {
+  QFile file(file_path);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return "Open layout pack failed";
+  }
+  // Packs are small, and their keys are copied into the tables anyway
+  auto image = file.readAll();
+  auto size = image.size();
+  auto data = reinterpret_cast<const uchar*>(image.constData());
+  if (size < kHeaderSize || memcmp(data, kMagic, sizeof(kMagic)) != 0) {
+    return "Not a layout pack";
+  }
+  if (qFromLittleEndian<quint32>(data + 4) != kVersion) {
+    return "Unsupported layout pack version";
+  }
+  auto key_count = qFromLittleEndian<quint32>(data + 8);
+  if (key_count > static_cast<quint64>(size - kHeaderSize) / kKeyEntrySize) {
+    return "Layout pack keys are truncated";
+  }
+  for (quint32 idx = 0; idx < key_count; ++ idx) {
+    auto entry = data + kHeaderSize + idx * kKeyEntrySize;
+    auto scan_code = qFromLittleEndian<quint16>(entry);
+    auto name_length = qFromLittleEndian<quint16>(entry + 2);
+    auto name_offset = qFromLittleEndian<quint32>(entry + 4);
+    if (name_offset + static_cast<quint64>(name_length) * 2 > static_cast<quint64>(size)) {
+      return "Layout pack key is out of range";
+    }
+    QString key_name(name_length, Qt::Uninitialized);
+    for (int char_idx = 0; char_idx < name_length; ++ char_idx) {
+      key_name[char_idx] = QChar(qFromLittleEndian<quint16>(data + name_offset + char_idx * 2));
+    }
+    key_names_.append(key_name);
+    // The first key wins, as in the built-in layouts
+    if (!key_name_of_scan_code_.contains(scan_code)) {
+      key_name_of_scan_code_.insert(scan_code, key_name);
+    }
+    if (!scan_code_of_key_name_.contains(key_name)) {
+      scan_code_of_key_name_.insert(key_name, scan_code);
+    }
+  }
+  return QString();
+}
+
+const QStringList& LayoutPack::getKeyNames() const {
+  return key_names_;
+}
+
+QString LayoutPack::getKeyNameOf(uint16_t scan_code) const {
+  return key_name_of_scan_code_.value(scan_code);
+}
+
+uint16_t LayoutPack::getScanCodeOf(const QString& key_name) const {
+  return scan_code_of_key_name_.value(key_name, 0);
+}
+
+const QStringList& getLayoutPackNames() {
+  // Only the directory is listed, no pack is opened
+  static const QStringList names = [] {
+    QStringList names;
+    for (auto& file_info : QDir(getLayoutPackDir()).entryInfoList(
+             {"*.sklp"}, QDir::Files, QDir::Name)) {
+      auto name = file_info.completeBaseName();
+      if (name != getStringOfKeyboardType(KeyboardType::kUS)
+          && name != getStringOfKeyboardType(KeyboardType::kJP)) {
+        names.append(name);
+      }
+    }
+    return names;
+  }();
+  return names;
+}
+
+const LayoutPack* getLayoutPackOf(KeyboardType keyboard_type) {
+  auto idx = static_cast<int>(keyboard_type) - kFirstLayoutPack;
+  auto& names = getLayoutPackNames();
+  if (idx < 0 || idx >= names.count()) {
+    return nullptr;
+  }
+  auto& cache = getLayoutPackCache();
+  QMutexLocker locker(&cache.mutex);
+  if (cache.loaded.empty()) {
+    cache.packs.resize(names.count());
+    cache.loaded.resize(names.count());
+  }
+  if (!cache.loaded[idx]) {
+    cache.loaded[idx] = true;
+    auto pack = std::make_unique<LayoutPack>();
+    auto pack_path = QDir(getLayoutPackDir()).filePath(names[idx] + ".sklp");
+    if (pack->open(pack_path).isEmpty()) {
+      cache.packs[idx] = std::move(pack);
+    }
+  }
+  return cache.packs[idx].get();
+}
+
+QString compileLayoutPack(const QString& source_path, const QString& pack_path) {
+  QList<LayoutKey> keys;
+  auto err_msg = readLayoutSource(source_path, &keys);
+  if (!err_msg.isEmpty()) {
+    return err_msg;
+  }
+
+  // Size everything up front so the image is allocated once
+  quint32 strings_offset = kHeaderSize + keys.count() * kKeyEntrySize;
+  quint32 strings_size = 0;
+  for (auto& key : keys) {
+    if (key.key_name.count() > 0xFFFF) {
+      return "Key name is too long";
+    }
+    strings_size += key.key_name.count() * 2;
+  }
+  QByteArray image(strings_offset + strings_size, '\0');
+  auto data = reinterpret_cast<uchar*>(image.data());
+  memcpy(data, kMagic, sizeof(kMagic));
+  qToLittleEndian<quint32>(kVersion, data + 4);
+  qToLittleEndian<quint32>(keys.count(), data + 8);
+  for (int idx = 0; idx < keys.count(); ++ idx) {
+    auto entry = data + kHeaderSize + idx * kKeyEntrySize;
+    qToLittleEndian<quint16>(keys[idx].scan_code, entry);
+    qToLittleEndian<quint16>(keys[idx].key_name.count(), entry + 2);
+    qToLittleEndian<quint32>(strings_offset, entry + 4);
+    for (auto ch : keys[idx].key_name) {
+      qToLittleEndian<quint16>(ch.unicode(), data + strings_offset);
+      strings_offset += 2;
+    }
+  }
+
+  QSaveFile file(pack_path);
+  if (!file.open(QIODevice::WriteOnly)) {
+    return "Open layout pack failed";
+  }
+  if (file.write(image) != image.count() || !file.commit()) {
+    return "Write layout pack failed";
+  }
+  return QString();
+}
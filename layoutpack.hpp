@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+#include "keyboarddefs.hpp"
+
+// Keyboard layouts beyond the built-in ones, installed as compiled layout
+// pack files (*.sklp) in the "layouts" directory next to the executable,
+// or in SETKEYMAP_LAYOUT_DIR. The file name is the keyboard type name, so
+// listing the packs opens no file. A pack is read into lookup tables
+// when its layout is first used.
+// Layout (all values little endian):
+//   Header  : "SKLP", version, key count
+//   Keys    : per key, scan code (16 bits), name length (16 bits) and
+//             name offset (32 bits), in the order of the key list
+//   Strings : UTF-16 names
+class LayoutPack {
+ public:
+  // Returns error message
+  QString open(const QString& file_path);
+
+  const QStringList& getKeyNames() const;
+  // Returns an empty string if the key is not in the layout
+  QString getKeyNameOf(uint16_t scan_code) const;
+  // Returns 0 if the name is not in the layout
+  uint16_t getScanCodeOf(const QString& key_name) const;
+
+ private:
+  QStringList key_names_;
+  QHash<uint16_t, QString> key_name_of_scan_code_;
+  QHash<QString, uint16_t> scan_code_of_key_name_;
+};
+
+// Returns the names of the installed layout packs. Keyboard type
+// kFirstLayoutPack + idx is the pack of the idx-th name.
+const QStringList& getLayoutPackNames();
+
+// Returns the pack of a keyboard type, loading it on first use, or
+// nullptr if it is not a layout pack or can't be loaded
+const LayoutPack* getLayoutPackOf(KeyboardType keyboard_type);
+
+// Compiles a layout source into a pack. Returns error message.
+// A source is UTF-8 text with one key per line: a hex scan code, then
+// whitespace and the key name. "base <type>" starts from the keys of a
+// built-in keyboard type, whose names are replaced per scan code; an
+// empty name removes the key. Lines starting with '#' are comments.
+QString compileLayoutPack(const QString& source_path, const QString& pack_path);
@@ -4,14 +4,26 @@
 
 #include <QApplication>
 
+#include "commandline.hpp"
+#include "trace.hpp"
 #include "winutil.hpp"
 #include "mainwindow.hpp"
 
 int main(int argc, char* argv[]) {
+  initTracing(&argc, argv);
+  TraceSpan span("main");
   QCoreApplication::setOrganizationName("SetKeyMap");
   QCoreApplication::setApplicationName("SetKeyMap");
+  if (isCommandLineMode(argc, argv)) {
+    return runCommandLine(argc, argv);
+  }
   QApplication a(argc, argv);
-  if (ensureAdminPrivilege()) {
+  bool has_admin_privilege = false;
+  {
+    TraceSpan elevation_span("ensureAdminPrivilege");
+    has_admin_privilege = ensureAdminPrivilege();
+  }
+  if (has_admin_privilege) {
     MainWindow w;
     w.show();
     return a.exec();
@@ -1,62 +1,114 @@
 #include "mainwindow.hpp"
 
+#include <QFileDialog>
 #include <QFormLayout>
-#include <QSettings>
 #include <QMenuBar>
 #include <QMenu>
 #include <QApplication>
+#include <QInputDialog>
 #include <QPushButton>
 #include <QMessageBox>
-#include <QDir>
+#include <QThread>
+#include <QTimer>
+#include <QtConcurrent>
 
 #include "editkeymapdialog.hpp"
+#include "keymapalgebra.hpp"
+#include "keymapexport.hpp"
+#include "trace.hpp"
 
 namespace {
 
-class Settings : public QSettings {
+// Names added to the list per event loop iteration
+const int kNameBatchSize = 200;
+
+QString getKeyLabelOf(KeyboardType keyboard_type, uint16_t scan_code) {
+  if (scan_code == kDisabledKey) {
+    return "(Disabled)";
+  }
+  return isKeyDefined(keyboard_type, scan_code)
+      ? getKeyNameOf(keyboard_type, scan_code)
+      : "0x" + QString("%1").arg(scan_code, 4, 16, QChar('0')).toUpper();
+}
+
+// Holds the reloads of profile_store while it lives. Rows and names which
+// are looked up before a modal dialog stay valid until it is closed.
+class ReloadSuspension {
  public:
-  Settings()
-      : QSettings(QDir(QCoreApplication::applicationDirPath()).filePath("keysetup.ini"),
-                  QSettings::IniFormat) {
+  explicit ReloadSuspension(ProfileStore* profile_store)
+      : profile_store_(profile_store) {
+    profile_store_->suspendReload();
   }
-  ~Settings() {
-    sync();
+  ~ReloadSuspension() {
+    profile_store_->resumeReload();
   }
-};
+  ReloadSuspension(const ReloadSuspension&) = delete;
+  ReloadSuspension& operator=(const ReloadSuspension&) = delete;
 
-void setKeyMapToSettings(const KeyMap& key_map) {
-  QByteArray key_code;
-  for (auto& key_map_entry : key_map.key_map) {
-    key_code.append((key_map_entry.map_to_key >> 0) & 0xFF);
-    key_code.append((key_map_entry.map_to_key >> 8) & 0xFF);
-    key_code.append((key_map_entry.actual_key >> 0) & 0xFF);
-    key_code.append((key_map_entry.actual_key >> 8) & 0xFF);
-  }
-  Settings settings;
-  settings.beginGroup(key_map.name);
-  settings.setValue("kb_type", getStringOfKeyboardType(key_map.keyboard_type));
-  settings.setValue("code", key_code);
-}
+ private:
+  ProfileStore* profile_store_;
+};
 
 }  // namespace
 
-MainWindow::MainWindow(QWidget* parent)
+MainWindow::MainWindow(const QString& profile_file_path, QWidget* parent)
     : QMainWindow(parent) {
+  TraceSpan span("MainWindow::MainWindow");
   createActions_();
   createWidgets_();
   initWidgetValues_();
   createMenus_();
   createConnections_();
   updateButtonState_();
+
+  // The profile file and the current key map are read on worker threads,
+  // so that the window shows up regardless of their size and latency
+  auto main_thread = thread();
+  profile_store_watcher_.setFuture(QtConcurrent::run([profile_file_path, main_thread] {
+    TraceSpan span("MainWindow::loadProfileStore");
+    auto profile_store = new ProfileStore(profile_file_path);
+    profile_store->moveToThread(main_thread);
+    return profile_store;
+  }));
+  current_key_map_watcher_.setFuture(QtConcurrent::run([] {
+    TraceSpan span("MainWindow::loadCurrentKeyMap");
+    return loadKeyMap();
+  }));
+}
+
+MainWindow::~MainWindow() {
+  // A store which is still loading isn't owned by the window yet
+  if (!profile_store_) {
+    profile_store_watcher_.waitForFinished();
+    delete profile_store_watcher_.result();
+    return;
+  }
+  // Changes which are still pending are written here, where a failure
+  // can still be shown. The store is deleted right after, so that it
+  // doesn't retry and report to the window which is being destroyed.
+  auto err_msg = profile_store_->flush();
+  if (!err_msg.isEmpty()) {
+    showFlushError_(err_msg);
+  }
+  profile_store_->disconnect(this);
+  delete profile_store_;
+  profile_store_ = nullptr;
 }
 
 void MainWindow::createActions_() {
   add_key_map_action_ = new QAction("Add key map");
   edit_key_map_action_ = new QAction("Edit key map");
   delete_key_map_action_ = new QAction("Delete key map");
+  import_key_maps_action_ = new QAction("Import key maps...");
+  export_key_maps_action_ = new QAction("Export key maps...");
+  compose_key_maps_action_ = new QAction("Compose with...");
+  invert_key_map_action_ = new QAction("Invert");
+  diff_key_maps_action_ = new QAction("Diff with...");
+  merge_key_maps_action_ = new QAction("Merge...");
 }
 
 void MainWindow::createWidgets_() {
+  TraceSpan span("MainWindow::createWidgets_");
   current_key_map_name_ = new QLabel();
   key_map_select_ = new QListWidget();
   key_map_select_->setContextMenuPolicy(Qt::CustomContextMenu);
@@ -72,41 +124,94 @@ void MainWindow::createWidgets_() {
 }
 
 void MainWindow::initWidgetValues_() {
-  Settings settings;
-  for (auto& key_map_name : settings.childGroups()) {
-    auto keyboard_type_str = settings.value(key_map_name + "/kb_type", QString()).toString();
-    auto keyboard_type = getKeyboardTypeFromString(keyboard_type_str);
-    auto key_codes = settings.value(key_map_name + "/code", QByteArray()).toByteArray();
-    QList<KeyMapEntry> key_map;
-    for (int idx = 0; idx < key_codes.count() / 4; ++ idx) {
-      KeyMapEntry entry;
-      entry.map_to_key = key_codes[idx*4+0] + (key_codes[idx*4+1] << 8);
-      entry.actual_key = key_codes[idx*4+2] + (key_codes[idx*4+3] << 8);
-      key_map.append(entry);
+  TraceSpan span("MainWindow::initWidgetValues_");
+  current_key_map_name_->setText("Loading...");
+}
+
+void MainWindow::setProfileStore_() {
+  TraceSpan span("MainWindow::setProfileStore_");
+  profile_store_ = profile_store_watcher_.result();
+  profile_store_->setParent(this);
+  connect(profile_store_, &ProfileStore::flushFailed,
+          this, &MainWindow::showFlushError_);
+  connect(profile_store_, &ProfileStore::keyMapsReloaded,
+          this, &MainWindow::updateKeyMapNames_);
+  if (!profile_store_->getLoadError().isEmpty()) {
+    QMessageBox::warning(this, "Key map load error", profile_store_->getLoadError());
+  }
+  addKeyMapNames_();
+  updateCurrentKeyMapName_();
+}
+
+void MainWindow::addKeyMapNames_() {
+  // Names are added a batch at a time, so that the window stays
+  // responsive with a large profile file
+  auto last_idx = qMin(added_name_count_ + kNameBatchSize, profile_store_->count());
+  QStringList names;
+  for (int idx = added_name_count_; idx < last_idx; ++ idx) {
+    names.append(profile_store_->getName(idx));
+  }
+  key_map_select_->addItems(names);
+  added_name_count_ = last_idx;
+  if (added_name_count_ < profile_store_->count()) {
+    QTimer::singleShot(0, this, &MainWindow::addKeyMapNames_);
+  } else {
+    // The list follows the changes of the file from here on
+    profile_store_->watchFile();
+    updateButtonState_();
+  }
+}
+
+void MainWindow::updateKeyMapNames_(const QStringList& added_names,
+                                    const QStringList&,
+                                    const QStringList& removed_names) {
+  TraceSpan span("MainWindow::updateKeyMapNames_");
+  // Rows follow the order of the store, which keeps the order of the
+  // remaining key maps and appends the added ones. The selection stays
+  // on its item unless the item is removed.
+  for (auto& name : removed_names) {
+    for (auto item : key_map_select_->findItems(name, Qt::MatchExactly)) {
+      delete key_map_select_->takeItem(key_map_select_->row(item));
     }
-    key_maps_.append({key_map_name, keyboard_type, key_map});
-    key_map_select_->addItem(key_map_name);
   }
+  key_map_select_->addItems(added_names);
+  added_name_count_ = key_map_select_->count();
+  // Changed key maps keep their rows, but the applied key map may have got
+  // or lost its name
+  updateCurrentKeyMapName_();
+}
 
+void MainWindow::updateCurrentKeyMapName_() {
+  // Needs both the profiles and the current key map
+  if (!profile_store_ || !current_key_map_watcher_.isFinished()) {
+    return;
+  }
   QString current_name = "Unknown";
-  auto current_key_map = loadKeyMap();
+  auto current_key_map = current_key_map_watcher_.result();
   if (current_key_map.count() == 0) {
     current_name = "No key map";
   }
-  for (auto& key_map : key_maps_) {
-    if (key_map.key_map == current_key_map) {
-      current_name = key_map.name;
-      break;
-    }
+  auto found_name = profile_store_->findNameOf(current_key_map);
+  if (!found_name.isEmpty()) {
+    current_name = found_name;
   }
   current_key_map_name_->setText(current_name);
+  updateButtonState_();
 }
 
 void MainWindow::createMenus_() {
+  TraceSpan span("MainWindow::createMenus_");
   auto edit_menu = menuBar()->addMenu("&Edit");
   edit_menu->addAction(add_key_map_action_);
   edit_menu->addAction(edit_key_map_action_);
   edit_menu->addAction(delete_key_map_action_);
+  edit_menu->addAction(import_key_maps_action_);
+  edit_menu->addAction(export_key_maps_action_);
+  edit_menu->addSeparator();
+  edit_menu->addAction(compose_key_maps_action_);
+  edit_menu->addAction(invert_key_map_action_);
+  edit_menu->addAction(diff_key_maps_action_);
+  edit_menu->addAction(merge_key_maps_action_);
 }
 
 void MainWindow::createConnections_() {
@@ -124,12 +229,46 @@ void MainWindow::createConnections_() {
           this, &MainWindow::editKeyMap_);
   connect(delete_key_map_action_, &QAction::triggered,
           this, &MainWindow::deleteKeyMap_);
+  connect(import_key_maps_action_, &QAction::triggered,
+          this, &MainWindow::importKeyMaps_);
+  connect(export_key_maps_action_, &QAction::triggered,
+          this, &MainWindow::exportKeyMaps_);
+  connect(&import_watcher_, &QFutureWatcher<ImportFileResult>::finished,
+          this, &MainWindow::finishImport_);
+  connect(compose_key_maps_action_, &QAction::triggered,
+          this, &MainWindow::composeKeyMaps_);
+  connect(invert_key_map_action_, &QAction::triggered,
+          this, &MainWindow::invertKeyMap_);
+  connect(diff_key_maps_action_, &QAction::triggered,
+          this, &MainWindow::diffKeyMaps_);
+  connect(merge_key_maps_action_, &QAction::triggered,
+          this, &MainWindow::mergeKeyMaps_);
+  connect(&profile_store_watcher_, &QFutureWatcher<ProfileStore*>::finished,
+          this, &MainWindow::setProfileStore_);
+  connect(&current_key_map_watcher_, &QFutureWatcher<QList<KeyMapEntry>>::finished,
+          this, &MainWindow::updateCurrentKeyMapName_);
+}
+
+void MainWindow::showFlushError_(const QString& err_msg) {
+  QMessageBox::warning(this, "Key map save error", err_msg);
 }
 
 void MainWindow::updateButtonState_() {
   auto ok_button = buttons_->button(QDialogButtonBox::Ok);
   auto items = key_map_select_->selectedItems();
-  if (items.isEmpty()) {
+  // Nothing can be edited until all the key maps are listed
+  bool loaded = profile_store_ && key_map_select_->count() == profile_store_->count();
+  add_key_map_action_->setEnabled(loaded);
+  import_key_maps_action_->setEnabled(loaded && import_watcher_.isFinished());
+  export_key_maps_action_->setEnabled(loaded);
+  edit_key_map_action_->setEnabled(loaded && !items.isEmpty());
+  delete_key_map_action_->setEnabled(loaded && !items.isEmpty());
+  // Key map operations work on the selected key map
+  for (auto action : {compose_key_maps_action_, invert_key_map_action_,
+                      diff_key_maps_action_, merge_key_maps_action_}) {
+    action->setEnabled(loaded && !items.isEmpty());
+  }
+  if (!loaded || !current_key_map_watcher_.isFinished() || items.isEmpty()) {
     ok_button->setEnabled(false);
   } else {
     ok_button->setEnabled(
@@ -138,15 +277,14 @@ void MainWindow::updateButtonState_() {
 }
 
 void MainWindow::applyScanCodeMap_() {
+  TraceSpan span("MainWindow::applyScanCodeMap_");
   auto map_name = key_map_select_->selectedItems()[0]->text();
-  for (auto& key_map : key_maps_) {
-    if (key_map.name == map_name) {
-      auto err_msg = setKeyMap(key_map.key_map);
-      if (!err_msg.isEmpty()) {
-        QMessageBox::warning(this, "Registry update error", err_msg);
-        return;
-      }
-      break;
+  auto idx = profile_store_->indexOf(map_name);
+  if (idx >= 0) {
+    auto err_msg = setKeyMap(profile_store_->getKeyMap(idx).key_map);
+    if (!err_msg.isEmpty()) {
+      QMessageBox::warning(this, "Registry update error", err_msg);
+      return;
     }
   }
   QMessageBox::information(this, "Key map has been update",
@@ -156,6 +294,9 @@ void MainWindow::applyScanCodeMap_() {
 }
 
 void MainWindow::showContextMenu_(const QPoint&) {
+  if (!add_key_map_action_->isEnabled()) {
+    return;
+  }
   QMenu menu;
   menu.addAction(add_key_map_action_);
   menu.addAction(edit_key_map_action_);
@@ -179,6 +320,7 @@ void MainWindow::showContextMenu_(const QPoint&) {
 }
 
 void MainWindow::addKeyMap_() {
+  ReloadSuspension reload_suspension(profile_store_);
   QStringList existing_names;
   for (int i = 0; i < key_map_select_->count(); ++ i) {
     existing_names.append(key_map_select_->item(i)->text());
@@ -189,39 +331,284 @@ void MainWindow::addKeyMap_() {
     key_map.name = dialog.getName();
     key_map.keyboard_type = dialog.getKeyboardType();
     key_map.key_map = dialog.getKeyMap();
-    key_maps_.append(key_map);
+    profile_store_->setKeyMap(key_map);
     key_map_select_->addItem(key_map.name);
-    setKeyMapToSettings(key_map);
   }
 }
 
 void MainWindow::editKeyMap_() {
+  ReloadSuspension reload_suspension(profile_store_);
   QStringList existing_names;
   for (int i = 0; i < key_map_select_->count(); ++ i) {
     existing_names.append(key_map_select_->item(i)->text());
   }
   auto row = key_map_select_->selectionModel()->selectedIndexes()[0].row();
-  auto key_map = key_maps_[row];
+  auto key_map = profile_store_->getKeyMap(row);
+  auto keyboard_type_name = profile_store_->getKeyboardTypeName(row);
+  if (!getKeyboardTypeNames().contains(keyboard_type_name)) {
+    // The keyboard type is kept unless another one is chosen
+    QMessageBox::warning(this, "Edit key map",
+                         QString("Keyboard type '%1' of '%2' isn't installed. "
+                                 "Keys are shown as on %3.")
+                         .arg(keyboard_type_name, key_map.name,
+                              getStringOfKeyboardType(key_map.keyboard_type)));
+  }
   EditKeyMapDialog dialog(this, existing_names,
                           key_map.name, key_map.keyboard_type, key_map.key_map);
   if (dialog.exec() == QDialog::Accepted) {
-    key_maps_[row].keyboard_type = dialog.getKeyboardType();
-    key_maps_[row].key_map = dialog.getKeyMap();
-    setKeyMapToSettings(key_maps_[row]);
+    key_map.keyboard_type = dialog.getKeyboardType();
+    key_map.key_map = dialog.getKeyMap();
+    profile_store_->setKeyMap(key_map);
   }
 }
 
 void MainWindow::deleteKeyMap_() {
+  ReloadSuspension reload_suspension(profile_store_);
   auto row = key_map_select_->selectionModel()->selectedIndexes()[0].row();
-  auto key_map = key_maps_[row];
+  auto key_map = profile_store_->getKeyMap(row);
   auto ans = QMessageBox::question(this, "Delete key map",
                                    QString("Are you sure to delete '%1'").arg(key_map.name),
                                    QMessageBox::Yes | QMessageBox::No);
   if (ans == QMessageBox::Yes) {
-    key_maps_.removeOne(key_map);
+    profile_store_->removeKeyMap(key_map.name);
     auto item = key_map_select_->takeItem(row);
     delete item;
-    Settings settings;
-    settings.remove(key_map.name);
   }
 }
+
+void MainWindow::importKeyMaps_() {
+  auto dir_path = QFileDialog::getExistingDirectory(this, "Import key maps");
+  if (dir_path.isEmpty()) {
+    return;
+  }
+  bool ok = false;
+  auto keyboard_type_str = QInputDialog::getItem(
+      this, "Import key maps", "Keyboard type of key maps which don't specify one",
+      getKeyboardTypeNames(), 0, false, &ok);
+  if (!ok) {
+    return;
+  }
+  QApplication::setOverrideCursor(Qt::WaitCursor);
+  auto file_paths = findImportFiles(dir_path);
+  QApplication::restoreOverrideCursor();
+  if (file_paths.isEmpty()) {
+    QMessageBox::information(this, "Import key maps", "There is no file to import");
+    return;
+  }
+  // Files are parsed on the thread pool. The progress dialog is deleted
+  // when they are done, which disconnects it.
+  import_progress_ = new QProgressDialog("Reading files...", "Cancel",
+                                         0, file_paths.count(), this);
+  import_progress_->setWindowModality(Qt::WindowModal);
+  import_progress_->setMinimumDuration(500);
+  connect(&import_watcher_, &QFutureWatcher<ImportFileResult>::progressValueChanged,
+          import_progress_, &QProgressDialog::setValue);
+  connect(import_progress_, &QProgressDialog::canceled,
+          &import_watcher_, &QFutureWatcher<ImportFileResult>::cancel);
+  import_watcher_.setFuture(parseImportFiles(file_paths,
+                                             getKeyboardTypeFromString(keyboard_type_str)));
+  updateButtonState_();
+}
+
+void MainWindow::finishImport_() {
+  TraceSpan span("MainWindow::finishImport_");
+  delete import_progress_;
+  import_progress_ = nullptr;
+  updateButtonState_();
+  if (import_watcher_.isCanceled()) {
+    return;
+  }
+  // The plan is checked against the key maps as they are until it is added
+  ReloadSuspension reload_suspension(profile_store_);
+  auto plan = planImport(import_watcher_.future().results(), *profile_store_);
+  QMessageBox message_box(QMessageBox::Information, "Import key maps",
+                          describeImportPlan(plan), QMessageBox::Ok, this);
+  message_box.setDetailedText(describeImportDetails(plan));
+  if (!plan.key_maps.isEmpty()) {
+    message_box.setInformativeText("Do you want to add the key maps?");
+    message_box.setStandardButtons(QMessageBox::Ok | QMessageBox::Cancel);
+  }
+  if (message_box.exec() != QMessageBox::Ok || plan.key_maps.isEmpty()) {
+    return;
+  }
+  // Added together, so that they are written by a single flush
+  profile_store_->setKeyMaps(plan.key_maps);
+  QStringList names;
+  names.reserve(plan.key_maps.count());
+  for (auto& key_map : plan.key_maps) {
+    names.append(key_map.name);
+  }
+  key_map_select_->addItems(names);
+  added_name_count_ = key_map_select_->count();
+  // The applied key map may be one of them
+  updateCurrentKeyMapName_();
+}
+
+void MainWindow::exportKeyMaps_() {
+  auto file_path = QFileDialog::getSaveFileName(
+      this, "Export key maps", QString(),
+      "Hex dump (*.txt);;Registry file (*.reg);;JSON (*.json)");
+  if (file_path.isEmpty()) {
+    return;
+  }
+  auto err_msg = exportKeyMaps(profile_store_->getPackedKeyMaps(),
+                               getExportFormatOf(file_path), file_path);
+  if (!err_msg.isEmpty()) {
+    QMessageBox::warning(this, "Export error", err_msg);
+  }
+}
+
+int MainWindow::getSelectedRow_() const {
+  auto indexes = key_map_select_->selectionModel()->selectedIndexes();
+  return indexes.isEmpty() ? -1 : indexes[0].row();
+}
+
+int MainWindow::selectOtherKeyMap_(const QString& title, const QString& label, int row) {
+  // Returns -1 when canceled
+  auto names = profile_store_->getNames();
+  names.removeAt(row);
+  if (names.isEmpty()) {
+    QMessageBox::information(this, title, "There is no other key map");
+    return -1;
+  }
+  bool ok = false;
+  auto name = QInputDialog::getItem(this, title, label, names, 0, false, &ok);
+  return ok ? profile_store_->indexOf(name) : -1;
+}
+
+void MainWindow::addResultKeyMap_(const QString& title, const QString& suggested_name,
+                                  KeyboardType keyboard_type,
+                                  const QList<KeyMapEntry>& key_map) {
+  auto name = suggested_name;
+  while (true) {
+    bool ok = false;
+    name = QInputDialog::getText(this, title, "Name of the new key map",
+                                 QLineEdit::Normal, name, &ok);
+    if (!ok) {
+      return;
+    }
+    if (name.isEmpty()) {
+      continue;
+    }
+    if (profile_store_->indexOf(name) < 0) {
+      break;
+    }
+    QMessageBox::warning(this, title, QString("'%1' already exists").arg(name));
+  }
+  profile_store_->setKeyMap({name, keyboard_type, key_map});
+  key_map_select_->addItem(name);
+}
+
+void MainWindow::composeKeyMaps_() {
+  ReloadSuspension reload_suspension(profile_store_);
+  auto row = getSelectedRow_();
+  if (row < 0) {
+    return;
+  }
+  auto first = profile_store_->getKeyMap(row);
+  auto other_row = selectOtherKeyMap_("Compose key maps",
+                                      QString("Key map to apply after '%1'").arg(first.name),
+                                      row);
+  if (other_row < 0) {
+    return;
+  }
+  auto second = profile_store_->getKeyMap(other_row);
+  addResultKeyMap_("Compose key maps", QString("%1 + %2").arg(first.name, second.name),
+                   first.keyboard_type, composeKeyMaps(first.key_map, second.key_map));
+}
+
+void MainWindow::invertKeyMap_() {
+  ReloadSuspension reload_suspension(profile_store_);
+  auto row = getSelectedRow_();
+  if (row < 0) {
+    return;
+  }
+  auto key_map = profile_store_->getKeyMap(row);
+  QList<KeyMapEntry> inverted;
+  auto err_msg = invertKeyMap(key_map.key_map, &inverted);
+  if (!err_msg.isEmpty()) {
+    QMessageBox::warning(this, "Invert key map", err_msg);
+    return;
+  }
+  addResultKeyMap_("Invert key map", QString("%1 (inverted)").arg(key_map.name),
+                   key_map.keyboard_type, inverted);
+}
+
+void MainWindow::diffKeyMaps_() {
+  ReloadSuspension reload_suspension(profile_store_);
+  auto row = getSelectedRow_();
+  if (row < 0) {
+    return;
+  }
+  auto lhs = profile_store_->getKeyMap(row);
+  auto other_row = selectOtherKeyMap_("Diff key maps",
+                                      QString("Key map to compare with '%1'").arg(lhs.name),
+                                      row);
+  if (other_row < 0) {
+    return;
+  }
+  auto rhs = profile_store_->getKeyMap(other_row);
+  auto differences = diffKeyMaps(lhs.key_map, rhs.key_map);
+  if (differences.isEmpty()) {
+    QMessageBox::information(this, "Diff key maps",
+                             QString("'%1' and '%2' have the same effect")
+                             .arg(lhs.name, rhs.name));
+    return;
+  }
+  QStringList lines;
+  for (auto& difference : differences) {
+    lines.append(QString("%1: %2 / %3")
+                 .arg(getKeyLabelOf(lhs.keyboard_type, difference.actual_key),
+                      getKeyLabelOf(lhs.keyboard_type, difference.lhs_map_to_key),
+                      getKeyLabelOf(lhs.keyboard_type, difference.rhs_map_to_key)));
+  }
+  QMessageBox message_box(QMessageBox::Information, "Diff key maps",
+                          QString("%1 key(s) differ between '%2' and '%3'")
+                          .arg(differences.count()).arg(lhs.name, rhs.name),
+                          QMessageBox::Ok, this);
+  message_box.setDetailedText(lines.join("\n"));
+  message_box.exec();
+}
+
+void MainWindow::mergeKeyMaps_() {
+  ReloadSuspension reload_suspension(profile_store_);
+  auto row = getSelectedRow_();
+  if (row < 0) {
+    return;
+  }
+  auto ours = profile_store_->getKeyMap(row);
+  auto base_row = selectOtherKeyMap_("Merge key maps",
+                                     QString("Base key map of '%1'").arg(ours.name), row);
+  if (base_row < 0) {
+    return;
+  }
+  auto base = profile_store_->getKeyMap(base_row);
+  auto theirs_row = selectOtherKeyMap_("Merge key maps",
+                                       QString("Key map to merge into '%1'").arg(ours.name), row);
+  if (theirs_row < 0) {
+    return;
+  }
+  auto theirs = profile_store_->getKeyMap(theirs_row);
+  QList<KeyMapConflict> conflicts;
+  auto merged = mergeKeyMaps(base.key_map, ours.key_map, theirs.key_map, &conflicts);
+  if (!conflicts.isEmpty()) {
+    QStringList lines;
+    for (auto& conflict : conflicts) {
+      lines.append(QString("%1: %2 / %3 (base %4)")
+                   .arg(getKeyLabelOf(ours.keyboard_type, conflict.actual_key),
+                        getKeyLabelOf(ours.keyboard_type, conflict.ours_map_to_key),
+                        getKeyLabelOf(ours.keyboard_type, conflict.theirs_map_to_key),
+                        getKeyLabelOf(ours.keyboard_type, conflict.base_map_to_key)));
+    }
+    QMessageBox message_box(QMessageBox::Warning, "Merge key maps",
+                            QString("%1 key(s) conflict. The mappings of '%2' are used.")
+                            .arg(conflicts.count()).arg(ours.name),
+                            QMessageBox::Ok | QMessageBox::Cancel, this);
+    message_box.setDetailedText(lines.join("\n"));
+    if (message_box.exec() != QMessageBox::Ok) {
+      return;
+    }
+  }
+  addResultKeyMap_("Merge key maps", QString("%1 + %2").arg(ours.name, theirs.name),
+                   ours.keyboard_type, merged);
+}
@@ -5,25 +5,20 @@
 #include <QLabel>
 #include <QListWidget>
 #include <QDialogButtonBox>
+#include <QFutureWatcher>
+#include <QProgressDialog>
 
 #include "winutil.hpp"
 #include "keyboarddefs.hpp"
-
-struct KeyMap {
-  QString name;
-  KeyboardType keyboard_type;
-  QList<KeyMapEntry> key_map;
-  bool operator==(const KeyMap& rhs) const {
-    return name == rhs.name
-      && keyboard_type == rhs.keyboard_type
-      && key_map == rhs.key_map;
-  }
-};
+#include "keymapimport.hpp"
+#include "profilestore.hpp"
 
 class MainWindow : public QMainWindow {
   Q_OBJECT
  public:
-  MainWindow(QWidget* parent = nullptr);
+  MainWindow(const QString& profile_file_path = getDefaultProfileFilePath(),
+             QWidget* parent = nullptr);
+  ~MainWindow();
 
  private slots:
   void applyScanCodeMap_();
@@ -32,6 +27,18 @@ class MainWindow : public QMainWindow {
   void addKeyMap_();
   void editKeyMap_();
   void deleteKeyMap_();
+  void importKeyMaps_();
+  void finishImport_();
+  void exportKeyMaps_();
+  void composeKeyMaps_();
+  void invertKeyMap_();
+  void diffKeyMaps_();
+  void mergeKeyMaps_();
+  void setProfileStore_();
+  void addKeyMapNames_();
+  void updateCurrentKeyMapName_();
+  void updateKeyMapNames_(const QStringList& added_names, const QStringList& changed_names,
+                          const QStringList& removed_names);
 
  private:
   void createActions_();
@@ -39,12 +46,31 @@ class MainWindow : public QMainWindow {
   void initWidgetValues_();
   void createMenus_();
   void createConnections_();
+  void showFlushError_(const QString& err_msg);
+  int getSelectedRow_() const;
+  int selectOtherKeyMap_(const QString& title, const QString& label, int row);
+  void addResultKeyMap_(const QString& title, const QString& suggested_name,
+                        KeyboardType keyboard_type, const QList<KeyMapEntry>& key_map);
 
   QAction* add_key_map_action_;
   QAction* edit_key_map_action_;
   QAction* delete_key_map_action_;
+  QAction* import_key_maps_action_;
+  QAction* export_key_maps_action_;
+  QAction* compose_key_maps_action_;
+  QAction* invert_key_map_action_;
+  QAction* diff_key_maps_action_;
+  QAction* merge_key_maps_action_;
   QLabel* current_key_map_name_;
   QListWidget* key_map_select_;
   QDialogButtonBox* buttons_;
-  QList<KeyMap> key_maps_;
+  // Loaded on worker threads, and null until then
+  ProfileStore* profile_store_ = nullptr;
+  QFutureWatcher<ProfileStore*> profile_store_watcher_;
+  QFutureWatcher<QList<KeyMapEntry>> current_key_map_watcher_;
+  QFutureWatcher<ImportFileResult> import_watcher_;
+  // Shown while import_watcher_ runs
+  QProgressDialog* import_progress_ = nullptr;
+  // Names are added to key_map_select_ in batches, up to this index
+  int added_name_count_ = 0;
 };
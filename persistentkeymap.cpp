@@ -0,0 +1,127 @@
+#include "persistentkeymap.hpp"
+
+namespace {
+
+const int kBits = 5;
+const int kBranchCount = 1 << kBits;
+const int kMask = kBranchCount - 1;
+
+}  // namespace
+
+PersistentKeyMap::PersistentKeyMap(const QList<KeyMapEntry>& key_map)
+    : count_(key_map.count()) {
+  if (key_map.isEmpty()) {
+    return;
+  }
+  // Build full leaves, then group every level into parents until one node
+  // is left. The result is the same as appending one by one.
+  std::vector<NodePtr> nodes;
+  for (int idx = 0; idx < key_map.count(); idx += kBranchCount) {
+    auto leaf = std::make_shared<Node>();
+    for (int entry_idx = idx; entry_idx < key_map.count() && entry_idx < idx + kBranchCount;
+         ++ entry_idx) {
+      leaf->entries.push_back(key_map[entry_idx]);
+    }
+    nodes.push_back(std::move(leaf));
+  }
+  while (nodes.size() > 1) {
+    std::vector<NodePtr> parents;
+    for (size_t idx = 0; idx < nodes.size(); idx += kBranchCount) {
+      auto parent = std::make_shared<Node>();
+      for (auto child_idx = idx; child_idx < nodes.size() && child_idx < idx + kBranchCount;
+           ++ child_idx) {
+        parent->children.push_back(nodes[child_idx]);
+      }
+      parents.push_back(std::move(parent));
+    }
+    nodes.swap(parents);
+    shift_ += kBits;
+  }
+  root_ = nodes.front();
+}
+
+int PersistentKeyMap::count() const {
+  return count_;
+}
+
+const KeyMapEntry& PersistentKeyMap::at(int idx) const {
+  auto node = root_.get();
+  for (int level = shift_; level > 0; level -= kBits) {
+    node = node->children[(idx >> level) & kMask].get();
+  }
+  return node->entries[idx & kMask];
+}
+
+PersistentKeyMap PersistentKeyMap::set(int idx, const KeyMapEntry& entry) const {
+  auto result = *this;
+  result.root_ = setEntry_(root_, shift_, idx, entry);
+  return result;
+}
+
+PersistentKeyMap PersistentKeyMap::append(const KeyMapEntry& entry) const {
+  auto result = *this;
+  if (!root_) {
+    result.root_ = createPath_(0, entry);
+  } else if (count_ == (kBranchCount << shift_)) {
+    // The trie is full, so it grows by one level
+    auto root = std::make_shared<Node>();
+    root->children = {root_, createPath_(shift_, entry)};
+    result.root_ = std::move(root);
+    result.shift_ += kBits;
+  } else {
+    result.root_ = appendEntry_(root_, shift_, count_, entry);
+  }
+  ++ result.count_;
+  return result;
+}
+
+QList<KeyMapEntry> PersistentKeyMap::toList() const {
+  QList<KeyMapEntry> key_map;
+  key_map.reserve(count_);
+  for (int idx = 0; idx < count_; ++ idx) {
+    key_map.append(at(idx));
+  }
+  return key_map;
+}
+
+bool PersistentKeyMap::isSameVersion(const PersistentKeyMap& other) const {
+  return root_ == other.root_ && count_ == other.count_;
+}
+
+PersistentKeyMap::NodePtr PersistentKeyMap::setEntry_(const NodePtr& node, int level, int idx,
+                                                      const KeyMapEntry& entry) {
+  auto copy = std::make_shared<Node>(*node);
+  if (level == 0) {
+    copy->entries[idx & kMask] = entry;
+  } else {
+    auto& child = copy->children[(idx >> level) & kMask];
+    child = setEntry_(child, level - kBits, idx, entry);
+  }
+  return copy;
+}
+
+PersistentKeyMap::NodePtr PersistentKeyMap::appendEntry_(const NodePtr& node, int level, int idx,
+                                                         const KeyMapEntry& entry) {
+  auto copy = std::make_shared<Node>(*node);
+  if (level == 0) {
+    copy->entries.push_back(entry);
+    return copy;
+  }
+  size_t child_idx = (idx >> level) & kMask;
+  if (child_idx < copy->children.size()) {
+    copy->children[child_idx] = appendEntry_(copy->children[child_idx], level - kBits, idx, entry);
+  } else {
+    copy->children.push_back(createPath_(level - kBits, entry));
+  }
+  return copy;
+}
+
+PersistentKeyMap::NodePtr PersistentKeyMap::createPath_(int level, const KeyMapEntry& entry) {
+  auto node = std::make_shared<Node>();
+  if (level == 0) {
+    node->entries.push_back(entry);
+  } else {
+    node->children.push_back(createPath_(level - kBits, entry));
+  }
+  return node;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <QList>
+
+#include "scancodemap.hpp"
+
+// Immutable list of key map entries which shares structure between
+// versions. It is a 32-way trie of entries, so a copy is O(1), and set()
+// or append() copy only the path to one leaf, O(log n). Old versions stay
+// valid and share all the other nodes, so keeping many of them, e.g. as
+// undo snapshots, costs little memory.
+class PersistentKeyMap {
+ public:
+  PersistentKeyMap() = default;
+  explicit PersistentKeyMap(const QList<KeyMapEntry>& key_map);
+
+  int count() const;
+  const KeyMapEntry& at(int idx) const;
+  PersistentKeyMap set(int idx, const KeyMapEntry& entry) const;
+  PersistentKeyMap append(const KeyMapEntry& entry) const;
+  QList<KeyMapEntry> toList() const;
+  // Returns true if other is the same version, without comparing entries
+  bool isSameVersion(const PersistentKeyMap& other) const;
+
+ private:
+  struct Node {
+    // Either children (inner node) or entries (leaf)
+    std::vector<std::shared_ptr<const Node>> children;
+    std::vector<KeyMapEntry> entries;
+  };
+  using NodePtr = std::shared_ptr<const Node>;
+
+  static NodePtr setEntry_(const NodePtr& node, int level, int idx, const KeyMapEntry& entry);
+  static NodePtr appendEntry_(const NodePtr& node, int level, int idx, const KeyMapEntry& entry);
+  static NodePtr createPath_(int level, const KeyMapEntry& entry);
+
+  NodePtr root_;
+  int count_ = 0;
+  // Bits of an index above the leaf level, 5 per inner level
+  int shift_ = 0;
+};
@@ -0,0 +1,208 @@
+#include "profilelibrary.hpp"
+
+#include <cstring>
+
+#include <QSaveFile>
+#include <QtEndian>
+
+#include "keymaphash.hpp"
+
+namespace {
+
+const char kMagic[4] = {'S', 'K', 'M', 'L'};
+// Version 1 has no key map hash in the index
+const quint32 kVersion = 2;
+const int kHeaderSize = 12;
+
+// Offsets of the fields in an index entry
+const int kNameOffset = 0;
+const int kNameLength = 4;
+const int kKeyboardTypeOffset = 8;
+const int kKeyboardTypeLength = 12;
+const int kEntriesOffset = 16;
+const int kEntryCount = 20;
+const int kHash = 24;
+const int kIndexEntrySizeV1 = 24;
+const int kIndexEntrySize = 32;
+
+const int kKeyMapEntrySize = 4;
+
+quint32 readUInt32(const uchar* src) {
+  return qFromLittleEndian<quint32>(src);
+}
+
+void writeUInt32(quint32 value, uchar* dest) {
+  qToLittleEndian<quint32>(value, dest);
+}
+
+// Appends a string as UTF-16 and returns its offset
+quint32 appendString(const QString& str, uchar* data, quint32* offset) {
+  auto string_offset = *offset;
+  for (auto ch : str) {
+    qToLittleEndian<quint16>(ch.unicode(), data + *offset);
+    *offset += 2;
+  }
+  return string_offset;
+}
+
+}  // namespace
+
+ProfileLibrary::~ProfileLibrary() {
+  close();
+}
+
+QString ProfileLibrary::open(const QString& file_path) {
+  close();
+  file_.setFileName(file_path);
+  if (!file_.open(QIODevice::ReadOnly)) {
+    return "Open profile library failed";
+  }
+  size_ = file_.size();
+  data_ = size_ > 0 ? file_.map(0, size_) : nullptr;
+  QString err_msg;
+  if (data_ == nullptr) {
+    err_msg = "Map profile library failed";
+  } else if (size_ < kHeaderSize || memcmp(data_, kMagic, sizeof(kMagic)) != 0) {
+    err_msg = "Not a profile library";
+  } else if (readUInt32(data_ + 4) != 1 && readUInt32(data_ + 4) != kVersion) {
+    err_msg = "Unsupported profile library version";
+  } else {
+    version_ = readUInt32(data_ + 4);
+    index_entry_size_ = version_ == 1 ? kIndexEntrySizeV1 : kIndexEntrySize;
+    auto count = readUInt32(data_ + 8);
+    if (count > static_cast<quint64>(size_ - kHeaderSize) / index_entry_size_) {
+      err_msg = "Profile library index is truncated";
+    } else {
+      count_ = static_cast<int>(count);
+      for (int idx = 0; idx < count_ && err_msg.isEmpty(); ++ idx) {
+        auto entry = getIndexEntry_(idx);
+        quint64 name_end = readUInt32(entry + kNameOffset)
+            + static_cast<quint64>(readUInt32(entry + kNameLength)) * 2;
+        quint64 keyboard_type_end = readUInt32(entry + kKeyboardTypeOffset)
+            + static_cast<quint64>(readUInt32(entry + kKeyboardTypeLength)) * 2;
+        quint64 entries_end = readUInt32(entry + kEntriesOffset)
+            + static_cast<quint64>(readUInt32(entry + kEntryCount)) * kKeyMapEntrySize;
+        if (name_end > static_cast<quint64>(size_)
+            || keyboard_type_end > static_cast<quint64>(size_)
+            || entries_end > static_cast<quint64>(size_)) {
+          err_msg = "Profile library entry is out of range";
+        }
+      }
+    }
+  }
+  if (!err_msg.isEmpty()) {
+    close();
+  }
+  return err_msg;
+}
+
+void ProfileLibrary::close() {
+  if (data_ != nullptr) {
+    file_.unmap(const_cast<uchar*>(data_));
+    data_ = nullptr;
+  }
+  file_.close();
+  size_ = 0;
+  version_ = 0;
+  index_entry_size_ = 0;
+  count_ = 0;
+}
+
+bool ProfileLibrary::isOpen() const {
+  return data_ != nullptr;
+}
+
+int ProfileLibrary::count() const {
+  return count_;
+}
+
+QString ProfileLibrary::getName(int idx) const {
+  auto entry = getIndexEntry_(idx);
+  return getString_(readUInt32(entry + kNameOffset), readUInt32(entry + kNameLength));
+}
+
+KeyboardType ProfileLibrary::getKeyboardType(int idx) const {
+  return getKeyboardTypeFromString(getKeyboardTypeName(idx));
+}
+
+QString ProfileLibrary::getKeyboardTypeName(int idx) const {
+  auto entry = getIndexEntry_(idx);
+  return getString_(readUInt32(entry + kKeyboardTypeOffset), readUInt32(entry + kKeyboardTypeLength));
+}
+
+QByteArray ProfileLibrary::getRawKeyMap(int idx) const {
+  auto entry = getIndexEntry_(idx);
+  return QByteArray::fromRawData(
+      reinterpret_cast<const char*>(data_ + readUInt32(entry + kEntriesOffset)),
+      readUInt32(entry + kEntryCount) * kKeyMapEntrySize);
+}
+
+QList<KeyMapEntry> ProfileLibrary::getKeyMap(int idx) const {
+  QList<KeyMapEntry> key_map;
+  decodeKeyMapEntries(getRawKeyMap(idx), &key_map);
+  return key_map;
+}
+
+quint64 ProfileLibrary::getHash(int idx) const {
+  if (version_ == 1) {
+    return getKeyMapHash(getKeyMap(idx));
+  }
+  return qFromLittleEndian<quint64>(getIndexEntry_(idx) + kHash);
+}
+
+const uchar* ProfileLibrary::getIndexEntry_(int idx) const {
+  return data_ + kHeaderSize + idx * index_entry_size_;
+}
+
+QString ProfileLibrary::getString_(quint32 offset, quint32 length) const {
+  QString str(length, Qt::Uninitialized);
+  auto src = data_ + offset;
+  for (quint32 idx = 0; idx < length; ++ idx, src += 2) {
+    str[idx] = QChar(qFromLittleEndian<quint16>(src));
+  }
+  return str;
+}
+
+QString writeProfileLibrary(const QString& file_path, const QList<PackedKeyMap>& key_maps) {
+  // Size everything up front so the image is allocated once
+  quint32 entries_size = 0;
+  quint32 strings_size = 0;
+  QStringList keyboard_type_names;
+  for (auto& key_map : key_maps) {
+    auto keyboard_type_name = key_map.getKeyboardTypeName();
+    keyboard_type_names.append(keyboard_type_name);
+    entries_size += key_map.key_code.count();
+    strings_size += (key_map.name.count() + keyboard_type_name.count()) * 2;
+  }
+  quint32 entries_offset = kHeaderSize + key_maps.count() * kIndexEntrySize;
+  quint32 strings_offset = entries_offset + entries_size;
+  QByteArray image(strings_offset + strings_size, '\0');
+  auto data = reinterpret_cast<uchar*>(image.data());
+
+  memcpy(data, kMagic, sizeof(kMagic));
+  writeUInt32(kVersion, data + 4);
+  writeUInt32(key_maps.count(), data + 8);
+  for (int idx = 0; idx < key_maps.count(); ++ idx) {
+    auto& key_map = key_maps[idx];
+    auto entry = data + kHeaderSize + idx * kIndexEntrySize;
+    writeUInt32(appendString(key_map.name, data, &strings_offset), entry + kNameOffset);
+    writeUInt32(key_map.name.count(), entry + kNameLength);
+    writeUInt32(appendString(keyboard_type_names[idx], data, &strings_offset),
+                entry + kKeyboardTypeOffset);
+    writeUInt32(keyboard_type_names[idx].count(), entry + kKeyboardTypeLength);
+    memcpy(data + entries_offset, key_map.key_code.constData(), key_map.key_code.count());
+    writeUInt32(entries_offset, entry + kEntriesOffset);
+    writeUInt32(key_map.key_code.count() / kKeyMapEntrySize, entry + kEntryCount);
+    qToLittleEndian<quint64>(key_map.hash, entry + kHash);
+    entries_offset += key_map.key_code.count();
+  }
+
+  QSaveFile file(file_path);
+  if (!file.open(QIODevice::WriteOnly)) {
+    return "Open profile library failed";
+  }
+  if (file.write(image) != image.count() || !file.commit()) {
+    return "Write profile library failed";
+  }
+  return "";
+}
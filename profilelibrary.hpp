@@ -0,0 +1,56 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QString>
+
+#include "keymap.hpp"
+
+// Read-only view of a binary profile library file (*.skml), which holds a
+// large number of key maps in a form that can be memory-mapped.
+// Layout (all values little endian):
+//   Header   : "SKML", version, profile count
+//   Index    : per profile, offset and length of the name, of the keyboard
+//              type name and of the key map entries, and the key map hash
+//   Entries  : packed 4-byte key map entries, as saved in keysetup.ini
+//   Strings  : UTF-16 names
+// Only the index is read on open. Key maps are decoded on request.
+class ProfileLibrary {
+ public:
+  ProfileLibrary() = default;
+  ProfileLibrary(const ProfileLibrary&) = delete;
+  ProfileLibrary& operator=(const ProfileLibrary&) = delete;
+  ~ProfileLibrary();
+
+  // Returns error message
+  QString open(const QString& file_path);
+  void close();
+  bool isOpen() const;
+
+  int count() const;
+  QString getName(int idx) const;
+  KeyboardType getKeyboardType(int idx) const;
+  // Returns the keyboard type name as saved
+  QString getKeyboardTypeName(int idx) const;
+  // Returns the packed entries without copying them out of the mapped file.
+  // The data is valid until the library is closed.
+  QByteArray getRawKeyMap(int idx) const;
+  QList<KeyMapEntry> getKeyMap(int idx) const;
+  // Returns getKeyMapHash() of the key map
+  quint64 getHash(int idx) const;
+
+ private:
+  const uchar* getIndexEntry_(int idx) const;
+  QString getString_(quint32 offset, quint32 length) const;
+
+  QFile file_;
+  const uchar* data_ = nullptr;
+  qint64 size_ = 0;
+  quint32 version_ = 0;
+  int index_entry_size_ = 0;
+  int count_ = 0;
+};
+
+// Writes key maps as a profile library. Returns error message
+QString writeProfileLibrary(const QString& file_path, const QList<PackedKeyMap>& key_maps);
@@ -0,0 +1,504 @@
+#include "profilestore.hpp"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QSettings>
+
+#include "keymaphash.hpp"
+#include "trace.hpp"
+
+namespace {
+
+const int kDefaultFlushDelay = 2000;
+const int kReloadDelay = 500;
+
+void writeKeyMap(QSettings& settings, const PackedKeyMap& key_map) {
+  settings.remove(key_map.name);
+  settings.beginGroup(key_map.name);
+  settings.setValue("kb_type", key_map.getKeyboardTypeName());
+  settings.setValue("code", key_map.key_code);
+  settings.endGroup();
+}
+
+// Returns the name to save for keyboard_type_str, which is empty unless
+// the keyboard type isn't known here
+QString getUnknownKeyboardType(const QString& keyboard_type_str) {
+  if (keyboard_type_str.isEmpty()
+      || getStringOfKeyboardType(getKeyboardTypeFromString(keyboard_type_str))
+         == keyboard_type_str) {
+    return QString();
+  }
+  return keyboard_type_str;
+}
+
+}  // namespace
+
+QString getDefaultProfileFilePath() {
+  QDir app_dir(QCoreApplication::applicationDirPath());
+  auto library_path = app_dir.filePath("keysetup.skml");
+  if (QFile::exists(library_path)) {
+    return library_path;
+  }
+  return app_dir.filePath("keysetup.ini");
+}
+
+ProfileStore::ProfileStore(const QString& file_path, QObject* parent)
+    : QObject(parent),
+      file_path_(file_path),
+      flush_timer_(this),
+      reload_timer_(this) {
+  flush_timer_.setSingleShot(true);
+  flush_timer_.setInterval(kDefaultFlushDelay);
+  connect(&flush_timer_, &QTimer::timeout,
+          this, &ProfileStore::flushLater_);
+  reload_timer_.setSingleShot(true);
+  reload_timer_.setInterval(kReloadDelay);
+  connect(&reload_timer_, &QTimer::timeout,
+          this, &ProfileStore::reloadIni_);
+  TraceSpan span("ProfileStore::load");
+  if (isLibrary_()) {
+    loadLibrary_();
+  } else {
+    loadIni_();
+  }
+}
+
+ProfileStore::~ProfileStore() {
+  // Receivers which are destroyed before the store have to disconnect
+  // first, as a child store is deleted after its parent's destructor
+  auto err_msg = flush();
+  if (!err_msg.isEmpty()) {
+    emit flushFailed(err_msg);
+  }
+}
+
+QString ProfileStore::getFilePath() const {
+  return file_path_;
+}
+
+QString ProfileStore::getLoadError() const {
+  return load_error_;
+}
+
+int ProfileStore::count() const {
+  return key_maps_.count();
+}
+
+QString ProfileStore::getName(int idx) const {
+  return key_maps_[idx].name;
+}
+
+QStringList ProfileStore::getNames() const {
+  QStringList names;
+  names.reserve(key_maps_.count());
+  for (auto& key_map : key_maps_) {
+    names.append(key_map.name);
+  }
+  return names;
+}
+
+KeyboardType ProfileStore::getKeyboardType(int idx) const {
+  return key_maps_[idx].keyboard_type;
+}
+
+QString ProfileStore::getKeyboardTypeName(int idx) const {
+  return key_maps_[idx].getKeyboardTypeName();
+}
+
+KeyMap ProfileStore::getKeyMap(int idx) const {
+  auto& packed_key_map = key_maps_[idx];
+  KeyMap key_map;
+  key_map.name = packed_key_map.name;
+  key_map.keyboard_type = packed_key_map.keyboard_type;
+  decodeKeyMapEntries(packed_key_map.key_code, &key_map.key_map);
+  return key_map;
+}
+
+const QList<PackedKeyMap>& ProfileStore::getPackedKeyMaps() const {
+  return key_maps_;
+}
+
+int ProfileStore::indexOf(const QString& name) const {
+  return name_index_.value(name, -1);
+}
+
+QString ProfileStore::findNameOf(const QList<KeyMapEntry>& key_map) const {
+  PackedKeyMap packed_key_map{QString(), KeyboardType::kUS,
+                              encodeKeyMapEntries(key_map), getKeyMapHash(key_map)};
+  auto names = getNamesOfSameKeyMap_(packed_key_map);
+  // The first one in the list wins
+  QString found_name;
+  int found_idx = key_maps_.count();
+  for (auto& name : names) {
+    auto idx = indexOf(name);
+    if (idx < found_idx) {
+      found_name = name;
+      found_idx = idx;
+    }
+  }
+  return found_name;
+}
+
+QList<QStringList> ProfileStore::findDuplicates() const {
+  QList<QStringList> duplicates;
+  QSet<QString> visited_names;
+  for (auto& key_map : key_maps_) {
+    if (visited_names.contains(key_map.name) || hash_index_.count(key_map.hash) < 2) {
+      continue;
+    }
+    auto names = getNamesOfSameKeyMap_(key_map);
+    for (auto& name : names) {
+      visited_names.insert(name);
+    }
+    if (names.count() > 1) {
+      duplicates.append(names);
+    }
+  }
+  return duplicates;
+}
+
+void ProfileStore::setKeyMap(const KeyMap& key_map) {
+  PackedKeyMap packed_key_map{key_map.name, key_map.keyboard_type,
+                              encodeKeyMapEntries(key_map.key_map),
+                              getKeyMapHash(key_map.key_map)};
+  auto idx = indexOf(key_map.name);
+  if (idx < 0) {
+    name_index_.insert(key_map.name, key_maps_.count());
+    key_maps_.append(packed_key_map);
+  } else {
+    // An unknown keyboard type shows up as kUS, and is kept unless
+    // another one is chosen
+    if (key_maps_[idx].keyboard_type == key_map.keyboard_type) {
+      packed_key_map.unknown_keyboard_type = key_maps_[idx].unknown_keyboard_type;
+    }
+    removeFromHashIndex_(key_maps_[idx]);
+    key_maps_[idx] = packed_key_map;
+  }
+  addToHashIndex_(packed_key_map);
+  markDirty_(key_map.name);
+}
+
+void ProfileStore::setKeyMaps(const QList<KeyMap>& key_maps) {
+  TraceSpan span("ProfileStore::setKeyMaps");
+  name_index_.reserve(key_maps_.count() + key_maps.count());
+  for (auto& key_map : key_maps) {
+    PackedKeyMap packed_key_map{key_map.name, key_map.keyboard_type,
+                                encodeKeyMapEntries(key_map.key_map),
+                                getKeyMapHash(key_map.key_map)};
+    auto found = name_index_.constFind(key_map.name);
+    if (found == name_index_.constEnd()) {
+      name_index_.insert(key_map.name, key_maps_.count());
+      key_maps_.append(packed_key_map);
+    } else {
+      if (key_maps_[*found].keyboard_type == key_map.keyboard_type) {
+        packed_key_map.unknown_keyboard_type = key_maps_[*found].unknown_keyboard_type;
+      }
+      removeFromHashIndex_(key_maps_[*found]);
+      key_maps_[*found] = packed_key_map;
+    }
+    addToHashIndex_(packed_key_map);
+    markDirty_(key_map.name);
+  }
+}
+
+void ProfileStore::removeKeyMap(const QString& name) {
+  auto idx = indexOf(name);
+  if (idx >= 0) {
+    removeFromHashIndex_(key_maps_[idx]);
+    key_maps_.removeAt(idx);
+    name_index_.remove(name);
+    updateNameIndex_(idx);
+    markDirty_(name);
+  }
+}
+
+void ProfileStore::watchFile() {
+  if (file_watcher_ || isLibrary_()) {
+    return;
+  }
+  file_watcher_ = new QFileSystemWatcher(this);
+  // The directory is watched until the file is created
+  file_watcher_->addPath(QFile::exists(file_path_)
+                         ? file_path_ : QFileInfo(file_path_).absolutePath());
+  connect(file_watcher_, &QFileSystemWatcher::fileChanged,
+          &reload_timer_, qOverload<>(&QTimer::start));
+  connect(file_watcher_, &QFileSystemWatcher::directoryChanged,
+          &reload_timer_, qOverload<>(&QTimer::start));
+}
+
+void ProfileStore::suspendReload() {
+  ++ reload_suspend_count_;
+}
+
+void ProfileStore::resumeReload() {
+  -- reload_suspend_count_;
+  if (reload_suspend_count_ == 0 && reload_pending_) {
+    reload_pending_ = false;
+    // Not reloaded right away, so that the caller finishes its edit first
+    reload_timer_.start();
+  }
+}
+
+void ProfileStore::setFlushDelay(int delay_ms) {
+  flush_timer_.setInterval(delay_ms);
+}
+
+bool ProfileStore::isDirty() const {
+  return !dirty_names_.isEmpty();
+}
+
+QString ProfileStore::flush() {
+  flush_timer_.stop();
+  if (dirty_names_.isEmpty()) {
+    return "";
+  }
+  TraceSpan span("ProfileStore::flush");
+  if (!load_error_.isEmpty()) {
+    // Never overwrite a file which couldn't be read
+    return load_error_;
+  }
+  auto err_msg = isLibrary_() ? flushLibrary_() : flushIni_();
+  if (err_msg.isEmpty()) {
+    dirty_names_.clear();
+  }
+  return err_msg;
+}
+
+bool ProfileStore::isLibrary_() const {
+  return file_path_.endsWith(".skml", Qt::CaseInsensitive);
+}
+
+QList<PackedKeyMap> ProfileStore::readIni_() const {
+  QList<PackedKeyMap> key_maps;
+  QSettings settings(file_path_, QSettings::IniFormat);
+  for (auto& key_map_name : settings.childGroups()) {
+    auto keyboard_type_str = settings.value(key_map_name + "/kb_type", QString()).toString();
+    auto keyboard_type = getKeyboardTypeFromString(keyboard_type_str);
+    auto key_code = settings.value(key_map_name + "/code", QByteArray()).toByteArray();
+    // The hash is always computed from the code, which may have been
+    // edited by hand. A "hash" value saved by an earlier version is
+    // ignored, and dropped when the group is written again.
+    QList<KeyMapEntry> key_map;
+    decodeKeyMapEntries(key_code, &key_map);
+    key_maps.append({key_map_name, keyboard_type, key_code, getKeyMapHash(key_map),
+                     getUnknownKeyboardType(keyboard_type_str)});
+  }
+  return key_maps;
+}
+
+void ProfileStore::loadIni_() {
+  key_maps_ = readIni_();
+  updateNameIndex_(0);
+  for (auto& key_map : key_maps_) {
+    addToHashIndex_(key_map);
+  }
+}
+
+void ProfileStore::reloadIni_() {
+  if (reload_suspend_count_ > 0) {
+    reload_pending_ = true;
+    return;
+  }
+  TraceSpan span("ProfileStore::reloadIni_");
+  if (!QFile::exists(file_path_)) {
+    // Editors may delete the file before writing it again, so the key
+    // maps are kept, and the directory is watched until it reappears
+    auto dir_path = QFileInfo(file_path_).absolutePath();
+    if (!file_watcher_->directories().contains(dir_path)) {
+      file_watcher_->addPath(dir_path);
+    }
+    return;
+  }
+  // A file which has been replaced, as by a flush, isn't watched anymore
+  if (!file_watcher_->files().contains(file_path_)) {
+    file_watcher_->addPath(file_path_);
+    if (!file_watcher_->directories().isEmpty()) {
+      file_watcher_->removePaths(file_watcher_->directories());
+    }
+  }
+  auto file_key_maps = readIni_();
+  QHash<QString, int> file_index;
+  file_index.reserve(file_key_maps.count());
+  for (int idx = 0; idx < file_key_maps.count(); ++ idx) {
+    file_index.insert(file_key_maps[idx].name, idx);
+  }
+
+  // Groups are compared by their contents. Dirty ones are written by the
+  // next flush, so the file doesn't override them.
+  QStringList added_names;
+  QStringList changed_names;
+  QStringList removed_names;
+  QList<PackedKeyMap> key_maps;
+  key_maps.reserve(file_key_maps.count() + dirty_names_.count());
+  QSet<QString> known_names;
+  for (auto& key_map : key_maps_) {
+    known_names.insert(key_map.name);
+    auto found = file_index.constFind(key_map.name);
+    if (dirty_names_.contains(key_map.name)) {
+      key_maps.append(key_map);
+    } else if (found == file_index.constEnd()) {
+      removeFromHashIndex_(key_map);
+      removed_names.append(key_map.name);
+    } else if (file_key_maps[*found].getKeyboardTypeName() != key_map.getKeyboardTypeName()
+               || file_key_maps[*found].key_code != key_map.key_code) {
+      removeFromHashIndex_(key_map);
+      key_maps.append(file_key_maps[*found]);
+      addToHashIndex_(key_maps.back());
+      changed_names.append(key_map.name);
+    } else {
+      key_maps.append(key_map);
+    }
+  }
+  for (auto& key_map : file_key_maps) {
+    if (!known_names.contains(key_map.name) && !dirty_names_.contains(key_map.name)) {
+      key_maps.append(key_map);
+      addToHashIndex_(key_maps.back());
+      added_names.append(key_map.name);
+    }
+  }
+  if (added_names.isEmpty() && changed_names.isEmpty() && removed_names.isEmpty()) {
+    return;
+  }
+  key_maps_ = key_maps;
+  name_index_.clear();
+  updateNameIndex_(0);
+  emit keyMapsReloaded(added_names, changed_names, removed_names);
+}
+
+void ProfileStore::loadLibrary_() {
+  if (!QFile::exists(file_path_)) {
+    return;
+  }
+  load_error_ = library_.open(file_path_);
+  key_maps_.reserve(library_.count());
+  name_index_.reserve(library_.count());
+  for (int idx = 0; idx < library_.count(); ++ idx) {
+    auto keyboard_type_name = library_.getKeyboardTypeName(idx);
+    key_maps_.append({library_.getName(idx), getKeyboardTypeFromString(keyboard_type_name),
+                      library_.getRawKeyMap(idx), library_.getHash(idx),
+                      getUnknownKeyboardType(keyboard_type_name)});
+    name_index_.insert(key_maps_.back().name, idx);
+    addToHashIndex_(key_maps_.back());
+  }
+}
+
+QString ProfileStore::flushIni_() {
+  // Groups which are not dirty are carried over from the current file as
+  // they are. The result is written to a temporary file first, then the
+  // current file is replaced in one step. The temporary file is removed
+  // whether that succeeds or not.
+  auto temp_path = file_path_ + ".tmp";
+  QFile::remove(temp_path);
+  auto err_msg = writeIni_(temp_path);
+  QFile::remove(temp_path);
+  return err_msg;
+}
+
+QString ProfileStore::writeIni_(const QString& temp_path) {
+  // A missing file, as deleted by another program, is written from all
+  // the key maps
+  bool has_file = QFile::exists(file_path_);
+  if (has_file && !QFile::copy(file_path_, temp_path)) {
+    return "Copy profile file failed";
+  }
+  {
+    QSettings settings(temp_path, QSettings::IniFormat);
+    if (has_file) {
+      for (auto& name : dirty_names_) {
+        auto idx = indexOf(name);
+        if (idx < 0) {
+          settings.remove(name);
+        } else {
+          writeKeyMap(settings, key_maps_[idx]);
+        }
+      }
+    } else {
+      for (auto& key_map : key_maps_) {
+        writeKeyMap(settings, key_map);
+      }
+    }
+    settings.sync();
+    if (settings.status() != QSettings::NoError) {
+      return "Write profile file failed";
+    }
+  }
+
+  QFile temp_file(temp_path);
+  QSaveFile file(file_path_);
+  if (!temp_file.open(QIODevice::ReadOnly) || !file.open(QIODevice::WriteOnly)) {
+    return "Open profile file failed";
+  }
+  auto data = temp_file.readAll();
+  if (file.write(data) != data.size() || !file.commit()) {
+    return "Write profile file failed";
+  }
+  return "";
+}
+
+QString ProfileStore::flushLibrary_() {
+  // The entries still refer to the mapped file, which can't be replaced
+  // while it is mapped
+  for (auto& key_map : key_maps_) {
+    key_map.key_code = QByteArray(key_map.key_code.constData(), key_map.key_code.count());
+  }
+  library_.close();
+  return writeProfileLibrary(file_path_, key_maps_);
+}
+
+void ProfileStore::updateNameIndex_(int first_idx) {
+  // Indexes of the key maps from first_idx on, which have been inserted
+  // or moved
+  name_index_.reserve(key_maps_.count());
+  for (int idx = first_idx; idx < key_maps_.count(); ++ idx) {
+    name_index_.insert(key_maps_[idx].name, idx);
+  }
+}
+
+void ProfileStore::addToHashIndex_(const PackedKeyMap& key_map) {
+  hash_index_.insert(key_map.hash, key_map.name);
+}
+
+void ProfileStore::removeFromHashIndex_(const PackedKeyMap& key_map) {
+  hash_index_.remove(key_map.hash, key_map.name);
+}
+
+QStringList ProfileStore::getNamesOfSameKeyMap_(const PackedKeyMap& key_map) const {
+  // Hash collisions are sorted out by comparing the canonical forms of
+  // candidates whose entries differ
+  QStringList names;
+  QList<KeyMapEntry> canonical_key_map;
+  bool decoded = false;
+  for (auto it = hash_index_.find(key_map.hash);
+       it != hash_index_.end() && it.key() == key_map.hash; ++ it) {
+    auto idx = indexOf(it.value());
+    if (key_maps_[idx].key_code != key_map.key_code) {
+      if (!decoded) {
+        QList<KeyMapEntry> entries;
+        decodeKeyMapEntries(key_map.key_code, &entries);
+        canonical_key_map = getCanonicalKeyMap(entries);
+        decoded = true;
+      }
+      if (getCanonicalKeyMap(getKeyMap(idx).key_map) != canonical_key_map) {
+        continue;
+      }
+    }
+    names.append(it.value());
+  }
+  return names;
+}
+
+void ProfileStore::markDirty_(const QString& name) {
+  dirty_names_.insert(name);
+  flush_timer_.start();
+}
+
+void ProfileStore::flushLater_() {
+  auto err_msg = flush();
+  if (!err_msg.isEmpty()) {
+    emit flushFailed(err_msg);
+  }
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QList>
+#include <QMultiHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+
+#include "keymap.hpp"
+#include "profilelibrary.hpp"
+
+// Returns the path of the profile file next to the executable.
+// keysetup.skml (profile library) is used if it exists, keysetup.ini
+// otherwise.
+QString getDefaultProfileFilePath();
+
+// Owns the saved key maps. The file is read once, and changes are kept in
+// memory until they are flushed together, either after a short delay or
+// at destruction. A flush rewrites the file atomically. A flush at
+// destruction which fails emits flushFailed(), so an owner which reports
+// errors itself should flush() and then disconnect before deleting it.
+// Key map entries are kept packed and decoded only on request. A profile
+// library is memory-mapped, so its entries are not even read until then.
+// A store can be created on a worker thread and then moved to the thread
+// which uses it, together with its flush timer.
+class ProfileStore : public QObject {
+  Q_OBJECT
+ public:
+  ProfileStore(const QString& file_path = getDefaultProfileFilePath(),
+               QObject* parent = nullptr);
+  ~ProfileStore();
+
+  QString getFilePath() const;
+  // Returns error message of reading the file
+  QString getLoadError() const;
+
+  int count() const;
+  QString getName(int idx) const;
+  QStringList getNames() const;
+  KeyboardType getKeyboardType(int idx) const;
+  // Returns the keyboard type name as saved, which may not be known here
+  QString getKeyboardTypeName(int idx) const;
+  KeyMap getKeyMap(int idx) const;
+  const QList<PackedKeyMap>& getPackedKeyMaps() const;
+  // Returns -1 if not found
+  int indexOf(const QString& name) const;
+  // Returns the name of the first key map which has the same canonical
+  // form as key_map, or an empty string if there is none
+  QString findNameOf(const QList<KeyMapEntry>& key_map) const;
+  // Returns groups of key maps which have the same canonical form
+  QList<QStringList> findDuplicates() const;
+
+  // Replaces the key map of the same name, or appends key_map
+  void setKeyMap(const KeyMap& key_map);
+  // Same as setKeyMap() for each of key_maps, with names looked up once
+  void setKeyMaps(const QList<KeyMap>& key_maps);
+  void removeKeyMap(const QString& name);
+
+  // Starts reloading the key maps which other programs change in the
+  // file. Only keysetup.ini is watched. Key maps which have been changed
+  // here and not flushed yet are kept, and so are all of them while the
+  // file is missing. Call on the thread which uses the store.
+  void watchFile();
+  // Reloads are held while the key maps are being edited by index or
+  // name, e.g. during a modal dialog, and a change of the file in the
+  // meantime is reloaded once the last suspension is resumed. Calls nest.
+  void suspendReload();
+  void resumeReload();
+
+  void setFlushDelay(int delay_ms);
+  bool isDirty() const;
+  // Returns error message
+  QString flush();
+
+ signals:
+  void flushFailed(const QString& err_msg);
+  // Emitted when the watched file has changed. Added key maps have been
+  // appended in file order, and the others keep their order.
+  void keyMapsReloaded(const QStringList& added_names, const QStringList& changed_names,
+                       const QStringList& removed_names);
+
+ private:
+  bool isLibrary_() const;
+  QList<PackedKeyMap> readIni_() const;
+  void loadIni_();
+  void reloadIni_();
+  void loadLibrary_();
+  QString flushIni_();
+  QString writeIni_(const QString& temp_path);
+  QString flushLibrary_();
+  void updateNameIndex_(int first_idx);
+  void addToHashIndex_(const PackedKeyMap& key_map);
+  void removeFromHashIndex_(const PackedKeyMap& key_map);
+  QStringList getNamesOfSameKeyMap_(const PackedKeyMap& key_map) const;
+  void markDirty_(const QString& name);
+  void flushLater_();
+
+  QString file_path_;
+  QString load_error_;
+  QList<PackedKeyMap> key_maps_;
+  ProfileLibrary library_;
+  // Key map name to its index in key_maps_
+  QHash<QString, int> name_index_;
+  // Key map hash to names
+  QMultiHash<quint64, QString> hash_index_;
+  QSet<QString> dirty_names_;
+  QTimer flush_timer_;
+  // Created by watchFile()
+  QFileSystemWatcher* file_watcher_ = nullptr;
+  // Editors write files in several steps, which are reloaded together
+  QTimer reload_timer_;
+  int reload_suspend_count_ = 0;
+  // The file has changed while reloads were suspended
+  bool reload_pending_ = false;
+};
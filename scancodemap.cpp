@@ -0,0 +1,141 @@
+#include "scancodemap.hpp"
+
+#include <QtEndian>
+
+namespace {
+
+const int kHeaderSize = 8;
+const int kCountSize = 4;
+const int kEntrySize = 4;
+const int kTerminatorSize = 4;
+
+// Hex digits of every byte value, so that formatting is a lookup per byte
+struct HexDigitTable {
+  HexDigitTable() {
+    const char digits[] = "0123456789ABCDEF";
+    for (int byte = 0; byte < 256; ++ byte) {
+      pairs[byte][0] = digits[byte >> 4];
+      pairs[byte][1] = digits[byte & 0xf];
+    }
+  }
+  char pairs[256][2];
+};
+
+const HexDigitTable kHexDigitTable;
+
+void writeEntries(const QList<KeyMapEntry>& key_map, uchar* dest) {
+  for (auto& entry : key_map) {
+    qToLittleEndian<quint16>(entry.map_to_key, dest + 0);
+    qToLittleEndian<quint16>(entry.actual_key, dest + 2);
+    dest += kEntrySize;
+  }
+}
+
+void readEntries(const uchar* src, int entry_count, QList<KeyMapEntry>* key_map) {
+  key_map->clear();
+  key_map->reserve(entry_count);
+  for (int idx = 0; idx < entry_count; ++ idx, src += kEntrySize) {
+    KeyMapEntry entry;
+    entry.map_to_key = qFromLittleEndian<quint16>(src + 0);
+    entry.actual_key = qFromLittleEndian<quint16>(src + 2);
+    key_map->append(entry);
+  }
+}
+
+}  // namespace
+
+int getScancodeMapSize(int entry_count) {
+  return kHeaderSize + kCountSize + entry_count * kEntrySize + kTerminatorSize;
+}
+
+QByteArray encodeScancodeMap(const QList<KeyMapEntry>& key_map) {
+  // Header and terminator stay zero
+  QByteArray scan_code(getScancodeMapSize(key_map.count()), '\0');
+  auto dest = reinterpret_cast<uchar*>(scan_code.data());
+  qToLittleEndian<quint32>(key_map.count() + 1, dest + kHeaderSize);
+  writeEntries(key_map, dest + kHeaderSize + kCountSize);
+  return scan_code;
+}
+
+QString decodeScancodeMap(const char* data, int size, QList<KeyMapEntry>* key_map) {
+  key_map->clear();
+  if (size < getScancodeMapSize(0)) {
+    return "Scancode map is too short";
+  }
+  auto src = reinterpret_cast<const uchar*>(data);
+  if (qFromLittleEndian<quint64>(src) != 0) {
+    return "Scancode map has unknown header";
+  }
+  auto count = qFromLittleEndian<quint32>(src + kHeaderSize);
+  if (count == 0 || count > static_cast<quint32>(size / kEntrySize)
+      || getScancodeMapSize(count - 1) != size) {
+    return "Scancode map has invalid entry count";
+  }
+  if (qFromLittleEndian<quint32>(src + size - kTerminatorSize) != 0) {
+    return "Scancode map is not terminated";
+  }
+  readEntries(src + kHeaderSize + kCountSize, count - 1, key_map);
+  return "";
+}
+
+QString decodeScancodeMap(const QByteArray& data, QList<KeyMapEntry>* key_map) {
+  return decodeScancodeMap(data.constData(), data.size(), key_map);
+}
+
+QByteArray encodeKeyMapEntries(const QList<KeyMapEntry>& key_map) {
+  QByteArray key_code(key_map.count() * kEntrySize, '\0');
+  writeEntries(key_map, reinterpret_cast<uchar*>(key_code.data()));
+  return key_code;
+}
+
+QString decodeKeyMapEntries(const char* data, int size, QList<KeyMapEntry>* key_map) {
+  key_map->clear();
+  if (size % kEntrySize != 0) {
+    return "Key map size is not a multiple of the entry size";
+  }
+  readEntries(reinterpret_cast<const uchar*>(data), size / kEntrySize, key_map);
+  return "";
+}
+
+QString decodeKeyMapEntries(const QByteArray& data, QList<KeyMapEntry>* key_map) {
+  return decodeKeyMapEntries(data.constData(), data.size(), key_map);
+}
+
+void appendScancodeMap(const QByteArray& key_code, QByteArray* out) {
+  char header[kHeaderSize + kCountSize] = {};
+  qToLittleEndian<quint32>(key_code.size() / kEntrySize + 1, header + kHeaderSize);
+  out->append(header, sizeof(header));
+  out->append(key_code);
+  out->append(kTerminatorSize, '\0');
+}
+
+QString encodeToHexString(const QByteArray& data) {
+  QByteArray hex_str;
+  appendHexString(data.constData(), data.size(), &hex_str);
+  return QString::fromLatin1(hex_str);
+}
+
+void appendHexString(const char* data, int size, QByteArray* out) {
+  // Each byte takes two digits and at most two separators
+  auto start = out->size();
+  out->resize(start + size * 4);
+  auto dest = out->data() + start;
+  for (int idx = 0; idx < size; ++ idx) {
+    if (idx % 8 != 0) {
+      *dest++ = ' ';
+      if (idx % 4 == 0) {
+        *dest++ = ' ';
+      }
+    } else if (idx != 0) {
+      *dest++ = '\n';
+    }
+    auto digits = kHexDigitTable.pairs[static_cast<uchar>(data[idx])];
+    *dest++ = digits[0];
+    *dest++ = digits[1];
+  }
+  out->resize(dest - out->constData());
+}
+
+const char* getHexDigitsOf(uchar byte) {
+  return kHexDigitTable.pairs[byte];
+}
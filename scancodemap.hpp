@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+struct KeyMapEntry {
+  uint16_t actual_key;
+  uint16_t map_to_key;
+  bool operator==(const KeyMapEntry& rhs) const {
+    return actual_key == rhs.actual_key && map_to_key == rhs.map_to_key;
+  }
+};
+
+// Layout of the "Scancode Map" registry value (all values little endian)
+//   8 bytes : header (version and flags, always zero)
+//   4 bytes : number of entries including the terminator
+//   4 bytes : each entry (map to key, actual key)
+//   4 bytes : terminator (zero)
+// Key maps saved in keysetup.ini hold only the 4-byte entries.
+
+// Returns the size in bytes of a Scancode Map value with entry_count entries
+int getScancodeMapSize(int entry_count);
+
+QByteArray encodeScancodeMap(const QList<KeyMapEntry>& key_map);
+
+// Decodes entries directly from data without copying it.
+// Returns error message
+QString decodeScancodeMap(const char* data, int size, QList<KeyMapEntry>* key_map);
+QString decodeScancodeMap(const QByteArray& data, QList<KeyMapEntry>* key_map);
+
+QByteArray encodeKeyMapEntries(const QList<KeyMapEntry>& key_map);
+// Appends the Scancode Map value of entries packed by encodeKeyMapEntries()
+void appendScancodeMap(const QByteArray& key_code, QByteArray* out);
+
+// Returns error message
+QString decodeKeyMapEntries(const char* data, int size, QList<KeyMapEntry>* key_map);
+QString decodeKeyMapEntries(const QByteArray& data, QList<KeyMapEntry>* key_map);
+
+// Formats data as hex bytes, 8 bytes per line in groups of 4
+QString encodeToHexString(const QByteArray& data);
+// Appends the same format in ASCII to out, whose capacity can be reused
+// over calls
+void appendHexString(const char* data, int size, QByteArray* out);
+// Returns the two upper case hex digits of byte (not null terminated)
+const char* getHexDigitsOf(uchar byte);
@@ -0,0 +1,163 @@
+#include "scancodemapstore.hpp"
+
+#include <cstring>
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QThread>
+
+#include "trace.hpp"
+
+namespace {
+
+const int kMaxReadAttempts = 8;
+
+QMutex& getActiveStoreMutex() {
+  static QMutex mutex;
+  return mutex;
+}
+
+std::unique_ptr<ScancodeMapStore>& getActiveStore() {
+  static std::unique_ptr<ScancodeMapStore> active_store;
+  return active_store;
+}
+
+std::unique_ptr<ScancodeMapStore> createDefaultScancodeMapStore() {
+  // The environment never selects the store, so that the installed tool
+  // always applies key maps to the registry. Harnesses set their own.
+#ifdef Q_OS_WIN
+  return createScancodeMapStore("registry");
+#else
+  return createScancodeMapStore(
+      "file:" + QDir(QCoreApplication::applicationDirPath()).filePath("scancodemap.bin"));
+#endif
+}
+
+}  // namespace
+
+QByteArray readSizedValue(const std::function<SizedReadStatus(char* buffer, quint32* size)>& read) {
+  quint32 size = 0;
+  if (read(nullptr, &size) == SizedReadStatus::kFailed) {
+    return QByteArray();
+  }
+  QByteArray buffer;
+  for (int attempt = 0; attempt < kMaxReadAttempts; ++ attempt) {
+    // The reported size may be stale, so the buffer grows at least twice
+    auto buffer_size = qMax<quint32>(size, buffer.size() * 2);
+    buffer.resize(static_cast<int>(buffer_size));
+    size = buffer_size;
+    auto status = read(buffer.data(), &size);
+    if (status == SizedReadStatus::kOk) {
+      buffer.resize(static_cast<int>(qMin(size, buffer_size)));
+      return buffer;
+    } else if (status == SizedReadStatus::kFailed) {
+      break;
+    }
+  }
+  return QByteArray();
+}
+
+QByteArray ScancodeMapStore::load() {
+  TraceSpan span("ScancodeMapStore::load");
+  QMutexLocker locker(&mutex_);
+  waitLatency_();
+  return loadData_();
+}
+
+QString ScancodeMapStore::save(const QByteArray& data) {
+  TraceSpan span("ScancodeMapStore::save");
+  QMutexLocker locker(&mutex_);
+  waitLatency_();
+  return saveData_(data);
+}
+
+void ScancodeMapStore::setLatency(int latency_ms) {
+  latency_ms_ = qMax(latency_ms, 0);
+}
+
+int ScancodeMapStore::getLatency() const {
+  return latency_ms_;
+}
+
+void ScancodeMapStore::waitLatency_() const {
+  if (latency_ms_ > 0) {
+    QThread::msleep(latency_ms_);
+  }
+}
+
+MemoryScancodeMapStore::MemoryScancodeMapStore(const QByteArray& data)
+    : data_(data) {
+}
+
+QByteArray MemoryScancodeMapStore::loadData_() {
+  return readSizedValue([this](char* buffer, quint32* size) {
+    auto buffer_size = *size;
+    *size = data_.size();
+    if (buffer == nullptr) {
+      return SizedReadStatus::kOk;
+    } else if (buffer_size < *size) {
+      return SizedReadStatus::kMoreData;
+    }
+    memcpy(buffer, data_.constData(), data_.size());
+    return SizedReadStatus::kOk;
+  });
+}
+
+QString MemoryScancodeMapStore::saveData_(const QByteArray& data) {
+  data_ = data;
+  return "";
+}
+
+FileScancodeMapStore::FileScancodeMapStore(const QString& file_path)
+    : file_path_(file_path) {
+}
+
+QByteArray FileScancodeMapStore::loadData_() {
+  QFile file(file_path_);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return QByteArray();
+  }
+  return file.readAll();
+}
+
+QString FileScancodeMapStore::saveData_(const QByteArray& data) {
+  QSaveFile file(file_path_);
+  if (!file.open(QIODevice::WriteOnly)) {
+    return "Open file failed";
+  }
+  if (file.write(data) != data.count() || !file.commit()) {
+    return "Write file failed";
+  }
+  return "";
+}
+
+std::unique_ptr<ScancodeMapStore> createScancodeMapStore(const QString& spec) {
+  std::unique_ptr<ScancodeMapStore> store;
+  if (spec == "memory") {
+    store.reset(new MemoryScancodeMapStore);
+  } else if (spec.startsWith("file:")) {
+    store.reset(new FileScancodeMapStore(spec.mid(5)));
+#ifdef Q_OS_WIN
+  } else if (spec == "registry") {
+    store.reset(new RegistryScancodeMapStore);
+#endif
+  }
+  return store;
+}
+
+ScancodeMapStore* getScancodeMapStore() {
+  QMutexLocker locker(&getActiveStoreMutex());
+  auto& active_store = getActiveStore();
+  if (!active_store) {
+    active_store = createDefaultScancodeMapStore();
+  }
+  return active_store.get();
+}
+
+void setScancodeMapStore(std::unique_ptr<ScancodeMapStore> store) {
+  QMutexLocker locker(&getActiveStoreMutex());
+  getActiveStore() = std::move(store);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include <QByteArray>
+#include <QMutex>
+#include <QString>
+#include <QtGlobal>
+
+// Storage of the raw "Scancode Map" value.
+// loadKeyMap() and setKeyMap() read and write through the active store.
+class ScancodeMapStore {
+ public:
+  virtual ~ScancodeMapStore() = default;
+
+  // Returns empty data if no value is stored
+  QByteArray load();
+  // Returns error messsage
+  QString save(const QByteArray& data);
+
+  // Delays every load and save, to emulate slow storage
+  void setLatency(int latency_ms);
+  int getLatency() const;
+
+ protected:
+  virtual QByteArray loadData_() = 0;
+  virtual QString saveData_(const QByteArray& data) = 0;
+
+ private:
+  void waitLatency_() const;
+
+  QMutex mutex_;
+  int latency_ms_ = 0;
+};
+
+enum class SizedReadStatus {
+  kOk,
+  kMoreData,
+  kFailed
+};
+
+// Reads a value of unknown size through read, which works as
+// RegQueryValueEx: it is called with a buffer and its size, and sets size
+// to the size of the value. A null buffer only queries the size, and
+// kMoreData means the buffer was too small. The buffer is grown and the
+// read retried, also when the value grows between the attempts.
+// Returns empty data on failure.
+QByteArray readSizedValue(const std::function<SizedReadStatus(char* buffer, quint32* size)>& read);
+
+#ifdef Q_OS_WIN
+// Stores the value in HKLM (implemented in winutil.cpp)
+class RegistryScancodeMapStore : public ScancodeMapStore {
+ protected:
+  QByteArray loadData_() override;
+  QString saveData_(const QByteArray& data) override;
+};
+#endif
+
+// Keeps the value in memory. Loads go through readSizedValue() the same
+// way as registry reads, so large values can be checked off Windows.
+class MemoryScancodeMapStore : public ScancodeMapStore {
+ public:
+  MemoryScancodeMapStore(const QByteArray& data = QByteArray());
+
+ protected:
+  QByteArray loadData_() override;
+  QString saveData_(const QByteArray& data) override;
+
+ private:
+  QByteArray data_;
+};
+
+class FileScancodeMapStore : public ScancodeMapStore {
+ public:
+  FileScancodeMapStore(const QString& file_path);
+
+ protected:
+  QByteArray loadData_() override;
+  QString saveData_(const QByteArray& data) override;
+
+ private:
+  QString file_path_;
+};
+
+// Creates a store from a spec: "registry", "memory" or "file:<path>".
+// Returns nullptr for an unknown spec.
+std::unique_ptr<ScancodeMapStore> createScancodeMapStore(const QString& spec);
+
+// Returns the active store. Unless one has been set, it is the registry
+// on Windows and scancodemap.bin next to the executable elsewhere.
+ScancodeMapStore* getScancodeMapStore();
+// Replaces the active store. Only harness entry points, such as the UI
+// latency harness, call this.
+void setScancodeMapStore(std::unique_ptr<ScancodeMapStore> store);
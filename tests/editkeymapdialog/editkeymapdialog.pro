@@ -0,0 +1,36 @@
+TEMPLATE = app
+TARGET = tst_editkeymapdialog
+INCLUDEPATH += . ../..
+QT += testlib widgets concurrent
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+DEFINES += QT_DEPRECATED_WARNINGS
+HEADERS += \
+        ../../winutil.hpp \
+        ../../trace.hpp \
+        ../../scancodemap.hpp \
+        ../../scancodemapstore.hpp \
+        ../../keymapanalyzer.hpp \
+        ../../keystrokesimulator.hpp \
+        ../../editkeymapdialog.hpp \
+        ../../keymaptablemodel.hpp \
+        ../../keyselectdelegate.hpp \
+        ../../keynameindex.hpp \
+        ../../persistentkeymap.hpp \
+        ../../keyboarddefs.hpp \
+        ../../layoutpack.hpp
+SOURCES += \
+        tst_editkeymapdialog.cpp \
+        ../../winutil.cpp \
+        ../../trace.cpp \
+        ../../scancodemap.cpp \
+        ../../scancodemapstore.cpp \
+        ../../keymapanalyzer.cpp \
+        ../../keystrokesimulator.cpp \
+        ../../editkeymapdialog.cpp \
+        ../../keymaptablemodel.cpp \
+        ../../keyselectdelegate.cpp \
+        ../../keynameindex.cpp \
+        ../../persistentkeymap.cpp \
+        ../../keyboarddefs.cpp \
+        ../../layoutpack.cpp
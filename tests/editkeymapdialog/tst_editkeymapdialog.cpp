@@ -0,0 +1,46 @@
+#include <QTableView>
+#include <QUndoStack>
+#include <QtTest>
+
+#include "editkeymapdialog.hpp"
+
+namespace {
+
+const uint16_t kCapsLock = 0x003a;
+const uint16_t kLeftCtrl = 0x001d;
+
+}  // namespace
+
+class EditKeyMapDialogTest : public QObject {
+  Q_OBJECT
+ private slots:
+  void unchangedKeyIsNotAnEdit();
+  void changedKeyIsAnEdit();
+};
+
+void EditKeyMapDialogTest::unchangedKeyIsNotAnEdit() {
+  EditKeyMapDialog dialog(nullptr, QStringList(), "Test", KeyboardType::kUS,
+                          {{kCapsLock, kLeftCtrl}});
+  auto model = dialog.findChild<QTableView*>()->model();
+  auto undo_stack = dialog.findChild<QUndoStack*>();
+  auto undo_count = undo_stack->count();
+  QSignalSpy data_changed(model, &QAbstractItemModel::dataChanged);
+  // As an editor which is closed without a change commits
+  QVERIFY(model->setData(model->index(0, KeyMapTableModel::kActualKeyColumn), kCapsLock));
+  QVERIFY(model->setData(model->index(0, KeyMapTableModel::kMapToKeyColumn), kLeftCtrl));
+  QCOMPARE(data_changed.count(), 0);
+  QCOMPARE(undo_stack->count(), undo_count);
+}
+
+void EditKeyMapDialogTest::changedKeyIsAnEdit() {
+  EditKeyMapDialog dialog(nullptr, QStringList(), "Test", KeyboardType::kUS,
+                          {{kCapsLock, kLeftCtrl}});
+  auto model = dialog.findChild<QTableView*>()->model();
+  auto undo_stack = dialog.findChild<QUndoStack*>();
+  auto undo_count = undo_stack->count();
+  QVERIFY(model->setData(model->index(0, KeyMapTableModel::kMapToKeyColumn), kCapsLock));
+  QCOMPARE(undo_stack->count(), undo_count + 1);
+}
+
+QTEST_MAIN(EditKeyMapDialogTest)
+#include "tst_editkeymapdialog.moc"
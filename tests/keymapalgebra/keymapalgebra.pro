@@ -0,0 +1,15 @@
+TEMPLATE = app
+TARGET = tst_keymapalgebra
+INCLUDEPATH += . ../..
+QT += testlib
+QT -= gui
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+DEFINES += QT_DEPRECATED_WARNINGS
+HEADERS += \
+        ../../scancodemap.hpp \
+        ../../keymapalgebra.hpp
+SOURCES += \
+        tst_keymapalgebra.cpp \
+        ../../scancodemap.cpp \
+        ../../keymapalgebra.cpp
@@ -0,0 +1,48 @@
+#include <QtTest>
+
+#include "keymapalgebra.hpp"
+
+namespace {
+
+const uint16_t kCapsLock = 0x003a;
+const uint16_t kLeftCtrl = 0x001d;
+const uint16_t kLeftAlt = 0x0038;
+
+}  // namespace
+
+class KeyMapAlgebraTest : public QObject {
+  Q_OBJECT
+ private slots:
+  void invertSwap();
+  void invertDisabledKey();
+  void invertTwoKeysToOne();
+  void invertKeyToUnmappedKey();
+};
+
+void KeyMapAlgebraTest::invertSwap() {
+  QList<KeyMapEntry> inverted;
+  QCOMPARE(invertKeyMap({{kCapsLock, kLeftCtrl}, {kLeftCtrl, kCapsLock}}, &inverted),
+           QString());
+  QCOMPARE(inverted, (QList<KeyMapEntry>{{kLeftCtrl, kCapsLock}, {kCapsLock, kLeftCtrl}}));
+}
+
+void KeyMapAlgebraTest::invertDisabledKey() {
+  QList<KeyMapEntry> inverted;
+  QVERIFY(!invertKeyMap({{kCapsLock, kDisabledKey}}, &inverted).isEmpty());
+}
+
+void KeyMapAlgebraTest::invertTwoKeysToOne() {
+  QList<KeyMapEntry> inverted;
+  QVERIFY(!invertKeyMap({{kCapsLock, kLeftAlt}, {kLeftCtrl, kLeftAlt},
+                         {kLeftAlt, kCapsLock}}, &inverted).isEmpty());
+}
+
+void KeyMapAlgebraTest::invertKeyToUnmappedKey() {
+  // Left Ctrl still produces itself, so it would have two sources
+  QList<KeyMapEntry> inverted;
+  QVERIFY(!invertKeyMap({{kCapsLock, kLeftCtrl}}, &inverted).isEmpty());
+  QVERIFY(inverted.isEmpty());
+}
+
+QTEST_GUILESS_MAIN(KeyMapAlgebraTest)
+#include "tst_keymapalgebra.moc"
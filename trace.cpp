@@ -0,0 +1,117 @@
+#include "trace.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QTextStream>
+
+namespace {
+
+struct Span {
+  const char* name;
+  qint64 start_ns;
+  qint64 end_ns;
+  int thread_id;
+};
+
+struct TraceState {
+  QMutex mutex;
+  QString file_path;
+  QElapsedTimer timer;
+  std::vector<Span> spans;
+};
+
+TraceState& getTraceState() {
+  static TraceState state;
+  return state;
+}
+
+// Small sequential ids read better in the viewer than native thread ids
+int getThreadId() {
+  static std::atomic<int> next_thread_id(1);
+  thread_local int thread_id = next_thread_id++;
+  return thread_id;
+}
+
+void writeTrace() {
+  trace_internal::enabled = false;
+  auto& state = getTraceState();
+  QMutexLocker locker(&state.mutex);
+  QSaveFile file(state.file_path);
+  if (!file.open(QIODevice::WriteOnly)) {
+    return;
+  }
+  QTextStream out(&file);
+  auto pid = QCoreApplication::applicationPid();
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  for (size_t idx = 0; idx < state.spans.size(); ++ idx) {
+    auto& span = state.spans[idx];
+    // Complete events, in microseconds
+    out << QString("{\"name\":\"%1\",\"ph\":\"X\",\"pid\":%2,\"tid\":%3,"
+                   "\"ts\":%4,\"dur\":%5}")
+        .arg(span.name).arg(pid).arg(span.thread_id)
+        .arg(span.start_ns / 1000.0, 0, 'f', 3)
+        .arg((span.end_ns - span.start_ns) / 1000.0, 0, 'f', 3)
+        << (idx + 1 < state.spans.size() ? ",\n" : "\n");
+  }
+  out << "]}\n";
+  out.flush();
+  file.commit();
+}
+
+}  // namespace
+
+namespace trace_internal {
+
+std::atomic<bool> enabled(false);
+
+qint64 getTime() {
+  return getTraceState().timer.nsecsElapsed();
+}
+
+void addSpan(const char* name, qint64 start_ns, qint64 end_ns) {
+  auto& state = getTraceState();
+  QMutexLocker locker(&state.mutex);
+  state.spans.push_back({name, start_ns, end_ns, getThreadId()});
+}
+
+}  // namespace trace_internal
+
+void initTracing(int* argc, char* argv[]) {
+  QString file_path = qEnvironmentVariable("SETKEYMAP_TRACE");
+  int arg_count = 1;
+  for (int idx = 1; idx < *argc; ++ idx) {
+    if (strcmp(argv[idx], "--trace") == 0 && idx + 1 < *argc) {
+      file_path = QString::fromLocal8Bit(argv[++ idx]);
+    } else if (strncmp(argv[idx], "--trace=", 8) == 0) {
+      file_path = QString::fromLocal8Bit(argv[idx] + 8);
+    } else {
+      argv[arg_count++] = argv[idx];
+    }
+  }
+  argv[arg_count] = nullptr;
+  *argc = arg_count;
+  if (!file_path.isEmpty()) {
+    startTracing(file_path);
+  }
+}
+
+void startTracing(const QString& file_path) {
+  auto& state = getTraceState();
+  {
+    QMutexLocker locker(&state.mutex);
+    if (!state.file_path.isEmpty()) {
+      return;
+    }
+    state.file_path = file_path;
+    state.timer.start();
+  }
+  std::atexit(writeTrace);
+  trace_internal::enabled = true;
+}
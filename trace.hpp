@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+
+#include <QString>
+#include <QtGlobal>
+
+// Scoped trace spans, written as Chrome trace event JSON which
+// chrome://tracing and Perfetto can open. Tracing is enabled by the
+// SETKEYMAP_TRACE environment variable or by --trace <file>, and the file
+// is written at exit. When disabled, a span costs one relaxed load.
+//
+//   void MainWindow::initWidgetValues_() {
+//     TraceSpan span("MainWindow::initWidgetValues_");
+//     ...
+
+// Starts tracing if it is requested, and removes --trace <file> from the
+// arguments so that the argument parsers don't see it
+void initTracing(int* argc, char* argv[]);
+// Starts tracing into file_path, which is written at exit
+void startTracing(const QString& file_path);
+
+namespace trace_internal {
+
+extern std::atomic<bool> enabled;
+
+qint64 getTime();
+void addSpan(const char* name, qint64 start_ns, qint64 end_ns);
+
+}  // namespace trace_internal
+
+inline bool isTracing() {
+  return trace_internal::enabled.load(std::memory_order_relaxed);
+}
+
+// name must be a string literal, as only the pointer is kept
+class TraceSpan {
+ public:
+  explicit TraceSpan(const char* name)
+      : name_(isTracing() ? name : nullptr),
+        start_ns_(name_ ? trace_internal::getTime() : 0) {
+  }
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+  ~TraceSpan() {
+    if (name_) {
+      trace_internal::addSpan(name_, start_ns_, trace_internal::getTime());
+    }
+  }
+
+ private:
+  const char* name_;
+  qint64 start_ns_;
+};
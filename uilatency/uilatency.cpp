@@ -0,0 +1,316 @@
+// Latency harness of the slow UI paths. It runs on the offscreen
+// platform with an in-memory Scancode Map store and generated profiles,
+// so it needs neither a display nor the registry. Prints JSON.
+//   --entries <count>          Entries of the edited key map (default 500)
+//   --profiles <count>         Key maps of the profile file (default 1000)
+//   --repeat <count>           Samples per action (default 20)
+//   --store-latency <ms>       Latency of the Scancode Map store
+//   --budget <action>=<ms>     Fails if the p90 of the action exceeds ms.
+//                              Can be repeated.
+//   --load-timeout <ms>        Fails if the main window doesn't finish
+//                              loading in time (default 60000)
+// Exits with 1 if a budget is exceeded or a load times out.
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QComboBox>
+#include <QDeadlineTimer>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFormLayout>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLabel>
+#include <QListWidget>
+#include <QPushButton>
+#include <QRandomGenerator>
+#include <QTableView>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QTimer>
+
+#include "editkeymapdialog.hpp"
+#include "keymaphash.hpp"
+#include "mainwindow.hpp"
+#include "profilestore.hpp"
+#include "scancodemapstore.hpp"
+#include "trace.hpp"
+
+namespace {
+
+const quint32 kSeed = 20200411;
+const int kProfileEntryCount = 16;
+// Upper bound of a single wait for events while loading
+const int kEventWaitMs = 100;
+
+struct LatencyResult {
+  QString action;
+  // Sorted samples in milliseconds
+  std::vector<double> samples_ms;
+};
+
+double getPercentile(const std::vector<double>& sorted_samples, int percentile) {
+  // Nearest rank
+  auto rank = (sorted_samples.size() * percentile + 99) / 100;
+  return sorted_samples[std::max<size_t>(rank, 1) - 1];
+}
+
+QList<KeyMapEntry> generateKeyMap(int entry_count, QRandomGenerator* random) {
+  auto key_names = getKeyNames(KeyboardType::kUS);
+  QList<KeyMapEntry> key_map;
+  for (int idx = 0; idx < entry_count; ++ idx) {
+    auto actual_key = getScanCodeOf(KeyboardType::kUS,
+                                    key_names[random->bounded(key_names.count())]);
+    auto map_to_key = getScanCodeOf(KeyboardType::kUS,
+                                    key_names[random->bounded(key_names.count())]);
+    key_map.append({actual_key, map_to_key});
+  }
+  return key_map;
+}
+
+// Writes profile_count key maps through the real profile store
+QString writeProfileFile(const QString& file_path, int profile_count, QRandomGenerator* random) {
+  ProfileStore profile_store(file_path);
+  for (int idx = 0; idx < profile_count; ++ idx) {
+    profile_store.setKeyMap({QString("profile%1").arg(idx), KeyboardType::kUS,
+                             generateKeyMap(kProfileEntryCount, random)});
+  }
+  return profile_store.flush();
+}
+
+// Runs setup untimed and then action timed, repeat times. Posted events
+// are processed inside the timed part, as the user waits for them too.
+LatencyResult measure(const QString& action_name, int repeat,
+                      const std::function<void()>& setup,
+                      const std::function<void()>& action) {
+  LatencyResult result{action_name, {}};
+  QElapsedTimer timer;
+  for (int idx = 0; idx < repeat; ++ idx) {
+    setup();
+    timer.start();
+    action();
+    QApplication::processEvents();
+    result.samples_ms.push_back(timer.nsecsElapsed() / 1e6);
+  }
+  std::sort(result.samples_ms.begin(), result.samples_ms.end());
+  return result;
+}
+
+template <class Widget>
+Widget* findWidget(QWidget* parent, const std::function<bool(Widget*)>& match) {
+  for (auto widget : parent->findChildren<Widget*>()) {
+    if (match(widget)) {
+      return widget;
+    }
+  }
+  return nullptr;
+}
+
+QComboBox* findKeyboardTypeSelect(QWidget* dialog) {
+  return findWidget<QComboBox>(dialog, [](QComboBox* combo_box) {
+    return combo_box->findText(getStringOfKeyboardType(KeyboardType::kJP)) >= 0;
+  });
+}
+
+QPushButton* findButton(QWidget* dialog, const QString& text) {
+  return findWidget<QPushButton>(dialog, [&](QPushButton* button) {
+    return button->text() == text;
+  });
+}
+
+// Processes events until the window lists profile_count key maps and
+// shows the name of the current one. Returns false if that takes longer
+// than timeout_ms.
+bool waitUntilLoaded(MainWindow* main_window, int profile_count, int timeout_ms) {
+  auto layout = qobject_cast<QFormLayout*>(main_window->centralWidget()->layout());
+  auto current_key_map_name = qobject_cast<QLabel*>(
+      layout->itemAt(0, QFormLayout::FieldRole)->widget());
+  auto key_map_select = main_window->findChild<QListWidget*>();
+  QDeadlineTimer deadline(timeout_ms);
+  // Wakes up the wait for events, so that the deadline is checked even if
+  // nothing else happens
+  QTimer wake_timer;
+  wake_timer.start(kEventWaitMs);
+  while (key_map_select->count() < profile_count
+         || current_key_map_name->text() == "Loading...") {
+    if (deadline.hasExpired()) {
+      return false;
+    }
+    QApplication::processEvents(QEventLoop::WaitForMoreEvents);
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  initTracing(&argc, argv);
+  QCoreApplication::setOrganizationName("SetKeyMap");
+  QCoreApplication::setApplicationName("SetKeyMap");
+  if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  }
+  QApplication app(argc, argv);
+  QCommandLineParser parser;
+  parser.setApplicationDescription("UI latency harness of SetKeyMap");
+  parser.addHelpOption();
+  QCommandLineOption entries_option("entries", "Entries of the edited key map.", "count", "500");
+  QCommandLineOption profiles_option("profiles", "Key maps of the profile file.", "count", "1000");
+  QCommandLineOption repeat_option("repeat", "Samples per action.", "count", "20");
+  QCommandLineOption store_latency_option(
+      "store-latency", "Latency of the Scancode Map store.", "ms", "0");
+  QCommandLineOption budget_option(
+      "budget", "Fails if the p90 latency of the action exceeds ms.", "action=ms");
+  QCommandLineOption load_timeout_option(
+      "load-timeout", "Fails if the main window doesn't finish loading in time.", "ms", "60000");
+  parser.addOptions({entries_option, profiles_option, repeat_option,
+                     store_latency_option, budget_option, load_timeout_option});
+  parser.process(app);
+
+  QTextStream out(stdout);
+  QTextStream err(stderr);
+  bool entries_ok = false;
+  bool profiles_ok = false;
+  bool repeat_ok = false;
+  bool store_latency_ok = false;
+  bool load_timeout_ok = false;
+  auto entry_count = parser.value(entries_option).toInt(&entries_ok);
+  auto profile_count = parser.value(profiles_option).toInt(&profiles_ok);
+  auto repeat = parser.value(repeat_option).toInt(&repeat_ok);
+  auto store_latency = parser.value(store_latency_option).toInt(&store_latency_ok);
+  auto load_timeout = parser.value(load_timeout_option).toInt(&load_timeout_ok);
+  if (!entries_ok || entry_count <= 0 || !profiles_ok || profile_count <= 0
+      || !repeat_ok || repeat <= 0 || !store_latency_ok || store_latency < 0
+      || !load_timeout_ok || load_timeout <= 0) {
+    err << "Counts must be positive numbers\n";
+    return 1;
+  }
+  QHash<QString, double> budgets_ms;
+  for (auto& budget : parser.values(budget_option)) {
+    auto parts = budget.split('=');
+    bool ok = false;
+    auto budget_ms = parts.count() == 2 ? parts[1].toDouble(&ok) : 0.0;
+    if (!ok) {
+      err << QString("Invalid budget '%1'\n").arg(budget);
+      return 1;
+    }
+    budgets_ms[parts[0]] = budget_ms;
+  }
+
+  // Stub Scancode Map store with a map which is not in the profiles
+  QRandomGenerator random(kSeed);
+  auto store = std::make_unique<MemoryScancodeMapStore>(
+      encodeScancodeMap(generateKeyMap(kProfileEntryCount, &random)));
+  store->setLatency(store_latency);
+  setScancodeMapStore(std::move(store));
+
+  QTemporaryDir temp_dir;
+  auto profile_file_path = QDir(temp_dir.path()).filePath("keysetup.ini");
+  auto err_msg = writeProfileFile(profile_file_path, profile_count, &random);
+  if (!err_msg.isEmpty()) {
+    err << err_msg << "\n";
+    return 1;
+  }
+  auto key_map = generateKeyMap(entry_count, &random);
+
+  QList<LatencyResult> results;
+  std::unique_ptr<MainWindow> main_window;
+  results.append(measure(
+      "mainwindow/startup", repeat,
+      [&] { main_window.reset(); },
+      [&] {
+        main_window = std::make_unique<MainWindow>(profile_file_path);
+        main_window->show();
+      }));
+  // Until the user can pick and apply a key map
+  bool loaded = true;
+  results.append(measure(
+      "mainwindow/loaded", repeat,
+      [&] { main_window.reset(); },
+      [&] {
+        main_window = std::make_unique<MainWindow>(profile_file_path);
+        main_window->show();
+        loaded = loaded && waitUntilLoaded(main_window.get(), profile_count, load_timeout);
+      }));
+  main_window.reset();
+  if (!loaded) {
+    err << QString("mainwindow/loaded: the key maps didn't load in %1 ms\n").arg(load_timeout);
+    return 1;
+  }
+
+  std::unique_ptr<EditKeyMapDialog> dialog;
+  auto open_dialog = [&] {
+    dialog = std::make_unique<EditKeyMapDialog>(nullptr, QStringList(), "Latency",
+                                                KeyboardType::kUS, key_map);
+    dialog->show();
+  };
+  results.append(measure("editdialog/open", repeat, [&] { dialog.reset(); }, open_dialog));
+
+  QComboBox* keyboard_type_select = nullptr;
+  results.append(measure(
+      "editdialog/updateKeyboardType", repeat,
+      [&] {
+        if (!dialog) {
+          open_dialog();
+        }
+        keyboard_type_select = findKeyboardTypeSelect(dialog.get());
+      },
+      [&] {
+        keyboard_type_select->setCurrentIndex(1 - keyboard_type_select->currentIndex());
+      }));
+
+  QPushButton* delete_button = nullptr;
+  results.append(measure(
+      "editdialog/deleteChecked", repeat,
+      [&] {
+        // Every other row, so that each removed run is a single row
+        open_dialog();
+        QApplication::processEvents();
+        auto model = dialog->findChild<QTableView*>()->model();
+        for (int row = 0; row < model->rowCount(); row += 2) {
+          model->setData(model->index(row, KeyMapTableModel::kCheckColumn),
+                         Qt::Checked, Qt::CheckStateRole);
+        }
+        delete_button = findButton(dialog.get(), "Delete checked");
+      },
+      [&] { delete_button->click(); }));
+  dialog.reset();
+
+  bool within_budget = true;
+  QJsonArray result_array;
+  for (auto& result : results) {
+    auto p90_ms = getPercentile(result.samples_ms, 90);
+    result_array.append(QJsonObject{
+        {"action", result.action},
+        {"samples", static_cast<int>(result.samples_ms.size())},
+        {"p50_ms", getPercentile(result.samples_ms, 50)},
+        {"p90_ms", p90_ms},
+        {"p99_ms", getPercentile(result.samples_ms, 99)},
+        {"max_ms", result.samples_ms.back()}});
+    if (budgets_ms.contains(result.action) && p90_ms > budgets_ms[result.action]) {
+      err << QString("%1: p90 %2 ms exceeds the budget of %3 ms\n")
+          .arg(result.action).arg(p90_ms).arg(budgets_ms[result.action]);
+      within_budget = false;
+    }
+    budgets_ms.remove(result.action);
+  }
+  for (auto& action : budgets_ms.keys()) {
+    err << QString("Unknown action '%1' in budget\n").arg(action);
+    within_budget = false;
+  }
+  QJsonObject context{
+    {"platform", QApplication::platformName()},
+    {"entry_count", entry_count},
+    {"profile_count", profile_count},
+    {"store_latency_ms", store_latency},
+  };
+  out << QJsonDocument(QJsonObject{{"context", context}, {"actions", result_array}}).toJson();
+  return within_budget ? 0 : 1;
+}
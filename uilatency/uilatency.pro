@@ -0,0 +1,51 @@
+TEMPLATE = app
+TARGET = uilatency
+INCLUDEPATH += . ..
+QT += widgets concurrent
+CONFIG += c++17 console
+CONFIG -= app_bundle
+DEFINES += QT_DEPRECATED_WARNINGS
+HEADERS += \
+        ../winutil.hpp \
+        ../trace.hpp \
+        ../scancodemap.hpp \
+        ../scancodemapstore.hpp \
+        ../keymap.hpp \
+        ../keymaphash.hpp \
+        ../keymapanalyzer.hpp \
+        ../keymapalgebra.hpp \
+        ../keymapexport.hpp \
+        ../keymapimport.hpp \
+        ../keystrokesimulator.hpp \
+        ../profilelibrary.hpp \
+        ../profilestore.hpp \
+        ../mainwindow.hpp \
+        ../editkeymapdialog.hpp \
+        ../keymaptablemodel.hpp \
+        ../keyselectdelegate.hpp \
+        ../keynameindex.hpp \
+        ../persistentkeymap.hpp \
+        ../keyboarddefs.hpp \
+        ../layoutpack.hpp
+SOURCES += \
+        uilatency.cpp \
+        ../winutil.cpp \
+        ../trace.cpp \
+        ../scancodemap.cpp \
+        ../scancodemapstore.cpp \
+        ../keymaphash.cpp \
+        ../keymapanalyzer.cpp \
+        ../keymapalgebra.cpp \
+        ../keymapexport.cpp \
+        ../keymapimport.cpp \
+        ../keystrokesimulator.cpp \
+        ../profilelibrary.cpp \
+        ../profilestore.cpp \
+        ../mainwindow.cpp \
+        ../editkeymapdialog.cpp \
+        ../keymaptablemodel.cpp \
+        ../keyselectdelegate.cpp \
+        ../keynameindex.cpp \
+        ../persistentkeymap.cpp \
+        ../keyboarddefs.cpp \
+        ../layoutpack.cpp
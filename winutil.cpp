@@ -1,11 +1,19 @@
 #include "winutil.hpp"
 
+#include <QtGlobal>
+#ifdef Q_OS_WIN
+#include <cstdio>
 #include <vector>
 #include <windows.h>
+#endif
 
-#include <QMessageBox>
 #include <QCoreApplication>
 
+#include "scancodemapstore.hpp"
+#include "trace.hpp"
+
+#ifdef Q_OS_WIN
+
 namespace {
 
 const QString kScancodePath = R"(SYSTEM\CurrentControlSet\Control\Keyboard Layout\Scancode Map)";
@@ -28,31 +36,12 @@ LPCWSTR toWinStr(const QString& str) {
   return reinterpret_cast<LPCWSTR>(str.utf16());
 }
 
-bool hasAdminPrivilege() {
-  bool has_admin = false;
-  HANDLE h_token;
-  if (OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY, &h_token)) {
-    TOKEN_ELEVATION elevation;
-    DWORD size = sizeof(TOKEN_ELEVATION);
-    if (GetTokenInformation(h_token, TokenElevation, &elevation, sizeof(elevation), &size)) {
-      has_admin = elevation.TokenIsElevated;
-    }
-  }
-  if (h_token) {
-    CloseHandle(h_token);
-  }
-  return has_admin;
-}
-
 }  // namespace
 
 QByteArray loadBinaryFromRegistry(const QString& key) {
-  const unsigned int max_length = 256;
+  TraceSpan span("loadBinaryFromRegistry");
   QByteArray result;
   HKEY h_key;
-  DWORD dw_type;
-  TCHAR lp_data[max_length];
-  DWORD dw_data_size;
   LONG ret;
 
   auto key_info = getKeyInfo(key);
@@ -60,39 +49,27 @@ QByteArray loadBinaryFromRegistry(const QString& key) {
   ret = RegOpenKeyEx(HKEY_LOCAL_MACHINE, toWinStr(key_info.sub_key),
                       0, KEY_QUERY_VALUE, &h_key);
   if (ret == ERROR_SUCCESS) {
-    dw_data_size = max_length;
-    ret = RegQueryValueEx(h_key, toWinStr(key_info.leaf_key),
-                           0, &dw_type, (LPBYTE)lp_data, &dw_data_size);
-    if (ret == ERROR_SUCCESS && dw_type == REG_BINARY) {
-      result = QByteArray(reinterpret_cast<const char*>(&lp_data[0]), dw_data_size);
-    }
+    // The size is queried first, and the read is retried with a larger
+    // buffer if the value has grown in between
+    result = readSizedValue([&](char* buffer, quint32* size) {
+      DWORD dw_type;
+      DWORD dw_data_size = *size;
+      auto ret = RegQueryValueEx(h_key, toWinStr(key_info.leaf_key),
+                                 0, &dw_type, reinterpret_cast<LPBYTE>(buffer), &dw_data_size);
+      *size = dw_data_size;
+      if (ret == ERROR_MORE_DATA) {
+        return SizedReadStatus::kMoreData;
+      }
+      return ret == ERROR_SUCCESS && dw_type == REG_BINARY
+          ? SizedReadStatus::kOk : SizedReadStatus::kFailed;
+    });
     RegCloseKey(h_key);
   }
   return result;
 }
 
-QList<KeyMapEntry> loadKeyMap() {
-  auto scan_code = loadBinaryFromRegistry(kScancodePath);
-  QList<KeyMapEntry> key_map;
-  if (scan_code.count() <= 16) {
-    return key_map;
-  }
-  int key_map_count =
-        (scan_code[8]  << 0)
-      + (scan_code[9]  << 8)
-      + (scan_code[10] << 16)
-      + (scan_code[11] << 24) - 1;
-  const int kOffset = 12;
-  for (int idx = kOffset; idx < key_map_count * 4 + kOffset && idx < scan_code.count(); idx += 4) {
-    KeyMapEntry entry;
-    entry.map_to_key = scan_code[idx+0] + (scan_code[idx+1] << 8);
-    entry.actual_key = scan_code[idx+2] + (scan_code[idx+3] << 8);
-    key_map.append(entry);
-  }
-  return key_map;
-}
-
 QString setBinaryToRegistry(const QString& key, const QByteArray& data) {
+  TraceSpan span("setBinaryToRegistry");
   HKEY h_key;
   DWORD dw_data_size;
   LONG ret;
@@ -114,29 +91,50 @@ QString setBinaryToRegistry(const QString& key, const QByteArray& data) {
   return "";
 }
 
+QByteArray RegistryScancodeMapStore::loadData_() {
+  return loadBinaryFromRegistry(kScancodePath);
+}
+
+QString RegistryScancodeMapStore::saveData_(const QByteArray& data) {
+  return setBinaryToRegistry(kScancodePath, data);
+}
+
+#endif  // Q_OS_WIN
+
+QList<KeyMapEntry> loadKeyMap() {
+  auto scan_code = getScancodeMapStore()->load();
+  QList<KeyMapEntry> key_map;
+  // An absent or malformed value is reported as no key map
+  decodeScancodeMap(scan_code, &key_map);
+  return key_map;
+}
+
 QString setKeyMap(const QList<KeyMapEntry>& key_map) {
-  // Create QByteArray object with header bytes
-  QByteArray scan_code(8, '\0');
-  int entry_count = key_map.count() + 1;
-  scan_code.append((entry_count >>  0) & 0xFF);
-  scan_code.append((entry_count >>  8) & 0xFF);
-  scan_code.append((entry_count >> 16) & 0xFF);
-  scan_code.append((entry_count >> 24) & 0xFF);
-  for (auto& entry : key_map) {
-    scan_code.append((entry.map_to_key >> 0) & 0xFF);
-    scan_code.append((entry.map_to_key >> 8) & 0xFF);
-    scan_code.append((entry.actual_key >> 0) & 0xFF);
-    scan_code.append((entry.actual_key >> 8) & 0xFF);
+  return getScancodeMapStore()->save(encodeScancodeMap(key_map));
+}
+
+bool hasAdminPrivilege() {
+#ifdef Q_OS_WIN
+  bool has_admin = false;
+  HANDLE h_token = NULL;
+  if (OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY, &h_token)) {
+    TOKEN_ELEVATION elevation;
+    DWORD size = sizeof(TOKEN_ELEVATION);
+    if (GetTokenInformation(h_token, TokenElevation, &elevation, sizeof(elevation), &size)) {
+      has_admin = elevation.TokenIsElevated;
+    }
   }
-  // Add footer bytes
-  scan_code.append('\0');
-  scan_code.append('\0');
-  scan_code.append('\0');
-  scan_code.append('\0');
-  return setBinaryToRegistry(kScancodePath, scan_code);
+  if (h_token) {
+    CloseHandle(h_token);
+  }
+  return has_admin;
+#else
+  return true;
+#endif
 }
 
 bool ensureAdminPrivilege() {
+#ifdef Q_OS_WIN
   if (!hasAdminPrivilege()) {
     // restart
     auto progPath = QCoreApplication::applicationFilePath();
@@ -151,5 +149,18 @@ bool ensureAdminPrivilege() {
                  SW_SHOWNORMAL);
     return false;
   }
+#endif
   return true;
 }
+
+void attachToParentConsole() {
+#ifdef Q_OS_WIN
+  auto h_stdout = GetStdHandle(STD_OUTPUT_HANDLE);
+  if ((h_stdout == NULL || h_stdout == INVALID_HANDLE_VALUE)
+      && AttachConsole(ATTACH_PARENT_PROCESS)) {
+    freopen("CONIN$", "r", stdin);
+    freopen("CONOUT$", "w", stdout);
+    freopen("CONOUT$", "w", stderr);
+  }
+#endif
+}